@@ -0,0 +1,120 @@
+#include "Blitter.h"
+
+Blitter::Blitter(const GBitmap& device, const Clip& clip, const GPaint& paint, const GMatrix& ctm,
+                 GPixel row[])
+    : fDevice(device), fClip(clip.bounds), fMask(clip.mask.get()), fShader(paint.peekShader()),
+      fPaintMode(paint.getBlendMode()), fMode(paint.getBlendMode()),
+      fColor(paint.getBlendMode(), ColorToPixel(paint.getColor())), fRow(row), fSkip(false) {
+    this->placeShader(ctm);
+}
+
+void Blitter::placeShader(const GMatrix& ctm) {
+    fSkip = false;
+    if (fShader) {
+        fMode = fPaintMode;
+        if (!fShader->setContext(ctm)) {
+            fSkip = true;  // A shader that can't be placed has nothing to draw
+        } else if (fShader->isOpaque()) {
+            fMode = optimize(fMode, 1.0f);
+        }
+    } else {
+        fMode = fColor.mode();
+    }
+
+    // Early exit if blend mode results in no changes, or the clip is empty
+    if (fMode == GBlendMode::kDst || fClip.isEmpty()) {
+        fSkip = true;
+    }
+}
+
+void Blitter::blitRow(int x, int y, int count) {
+    this->blitClipped(x, y, count, 0xFF);
+}
+
+void Blitter::blitRect(int left, int top, int right, int bottom) {
+    top = std::max(top, fClip.top);
+    bottom = std::min(bottom, fClip.bottom);
+    for (int y = top; y < bottom; ++y) {
+        this->blitRow(left, y, right - left);
+    }
+}
+
+void Blitter::blitAntiRun(int x, int y, int count, uint8_t coverage) {
+    if (coverage != 0) {
+        this->blitClipped(x, y, count, coverage);
+    }
+}
+
+void Blitter::blitClipped(int x, int y, int count, uint8_t coverage) {
+    if (fSkip || y < fClip.top || y >= fClip.bottom) {
+        return;
+    }
+
+    // Clip the span to the clip bounds
+    int left = std::max(x, fClip.left);
+    int right = std::min(x + count, fClip.right);
+    if (left >= right) {
+        return;
+    }
+
+    auto blit = [&](int start, int n) {
+        if (coverage == 0xFF) {
+            this->blitSpan(start, y, n);
+        } else {
+            this->blitPartial(start, y, n, coverage);
+        }
+    };
+
+    if (!fMask) {
+        blit(left, right - left);
+        return;
+    }
+
+    // Blit each run of covered pixels in the mask
+    const uint8_t* mask = fMask->row(y) - fMask->bounds.left;
+    while (left < right) {
+        while (left < right && mask[left] == 0) {
+            ++left;
+        }
+        int runEnd = left;
+        while (runEnd < right && mask[runEnd] != 0) {
+            ++runEnd;
+        }
+        if (runEnd > left) {
+            blit(left, runEnd - left);
+        }
+        left = runEnd;
+    }
+}
+
+void Blitter::blitSpan(int x, int y, int count) {
+    GPixel* dst = fDevice.getAddr(x, y);
+    if (fShader) {
+        fShader->shadeRow(x, y, count, fRow);
+        blendRow(fMode, fRow, dst, count);
+    } else {
+        fColor.blendRow(dst, count);
+    }
+}
+
+// Blend into a copy of dst, then move dst toward the copy by the coverage
+void Blitter::blitPartial(int x, int y, int count, uint8_t coverage) {
+    GPixel* dst = fDevice.getAddr(x, y);
+    if (fShader) {
+        fShader->shadeRow(x, y, count, fRow);
+    }
+
+    GPixel blended[256];
+    for (int done = 0; done < count; done += 256) {
+        int n = std::min(count - done, 256);
+        std::copy(dst + done, dst + done + n, blended);
+        if (fShader) {
+            blendRow(fMode, fRow + done, blended, n);
+        } else {
+            fColor.blendRow(blended, n);
+        }
+        for (int i = 0; i < n; ++i) {
+            dst[done + i] = lerpPixel(dst[done + i], blended[i], coverage);
+        }
+    }
+}
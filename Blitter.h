@@ -0,0 +1,82 @@
+#ifndef BLITTER_H
+#define BLITTER_H
+
+#include "include/GBitmap.h"
+#include "include/GMatrix.h"
+#include "include/GPaint.h"
+#include "include/GRect.h"
+#include "include/GShader.h"
+#include "my_blend.h"
+#include <memory>
+#include <vector>
+
+// Coverage of a complex clip: one byte per pixel of bounds, 0 (clipped out) or 255 (drawn).
+// Built once by clipPath() and shared by every save level and draw that uses it.
+struct ClipMask {
+    GIRect               bounds;
+    std::vector<uint8_t> coverage;
+
+    uint8_t* row(int y) {
+        return coverage.data() + static_cast<size_t>(y - bounds.top) * bounds.width();
+    }
+    const uint8_t* row(int y) const {
+        return coverage.data() + static_cast<size_t>(y - bounds.top) * bounds.width();
+    }
+};
+
+// Device-space clip for one save level. bounds is kept intersected with the device and with
+// the mask's bounds, so rect clips cost nothing beyond narrowing the rows and spans we visit.
+struct Clip {
+    GIRect                          bounds;
+    std::shared_ptr<const ClipMask> mask;
+};
+
+// Writes spans of a paint into the device. Built once per draw call, so the shader context,
+// the blend procedure and the source color are resolved once instead of once per span.
+class Blitter {
+public:
+    // row must hold at least device.width() pixels; it is used as scratch space for shaders.
+    // clip must outlive the blitter.
+    Blitter(const GBitmap& device, const Clip& clip, const GPaint& paint, const GMatrix& ctm,
+            GPixel row[]);
+
+    // Copy of another blitter that shades into its own scratch row, e.g. for another thread
+    Blitter(const Blitter& other, GPixel row[]) : Blitter(other) { fRow = row; }
+
+    // Copy of another blitter that shades with a different shader, e.g. a band's own copy.
+    // Call placeShader() before blitting.
+    Blitter(const Blitter& other, GShader* shader) : Blitter(other) { fShader = shader; }
+
+    // True if nothing this blitter writes can change the device
+    bool isNoop() const { return fSkip; }
+
+    // Places the shader again (setContext) and re-reduces the blend mode, for draws that
+    // re-point their shader between primitives, like drawMesh between triangles
+    void placeShader(const GMatrix& ctm);
+
+    // Blend [x, x + count) on row y, clipped to the clip
+    void blitRow(int x, int y, int count);
+
+    // Blend every row in [top, bottom) over [left, right), clipped to the clip
+    void blitRect(int left, int top, int right, int bottom);
+
+    // Blend [x, x + count) on row y, moving each pixel toward the result by coverage (0...255)
+    void blitAntiRun(int x, int y, int count, uint8_t coverage);
+
+private:
+    void blitClipped(int x, int y, int count, uint8_t coverage);
+    void blitSpan(int x, int y, int count);                       // Unclipped
+    void blitPartial(int x, int y, int count, uint8_t coverage);  // Unclipped
+
+    GBitmap         fDevice;
+    GIRect          fClip;    // Clip bounds, already within the device
+    const ClipMask* fMask;    // Null for rect clips
+    GShader*        fShader;
+    GBlendMode      fPaintMode;
+    GBlendMode      fMode;    // Blend mode for shaded rows, reduced when the shader is opaque
+    ColorBlender    fColor;   // Used instead of the shader path when there is no shader
+    GPixel*         fRow;
+    bool            fSkip;
+};
+
+#endif
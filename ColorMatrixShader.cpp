@@ -0,0 +1,223 @@
+#include "ColorMatrixShader.h"
+#include "my_utils.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// M[col * 4 + row] for the r, g, b, a columns; M[16 + row] is the translate column
+
+static bool isIdentity(const GColorMatrix& m) {
+    return m.fMat == GColorMatrix().fMat;
+}
+
+// Alpha passes through and r, g, b depend only on r, g, b (no alpha term and no translate)
+static bool isPremulLinear(const GColorMatrix& m) {
+    for (int row = 0; row < 3; ++row) {
+        if (m[12 + row] != 0 || m[16 + row] != 0) {
+            return false;
+        }
+    }
+    return m[3] == 0 && m[7] == 0 && m[11] == 0 && m[15] == 1 && m[19] == 0;
+}
+
+// True if every in-range color stays in range, so clamping after this matrix is a no-op
+static bool staysInRange(const GColorMatrix& m) {
+    for (int row = 0; row < 4; ++row) {
+        float lo = m[16 + row], hi = m[16 + row];
+        for (int col = 0; col < 4; ++col) {
+            float v = m[col * 4 + row];
+            (v < 0 ? lo : hi) += v;
+        }
+        if (lo < 0 || hi > 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// True if premultiplying this matrix's output can't lose its rgb: the output alpha never rounds
+// to 0, or it is at least the input alpha (so it is 0 only for transparent input, which
+// unpremuls to all zeros) and the rgb offsets keep that all zeros
+static bool keepsColorThroughPremul(const GColorMatrix& m) {
+    float lowestAlpha = m[19];
+    for (int col = 0; col < 4; ++col) {
+        lowestAlpha += std::min(m[col * 4 + 3], 0.0f);
+    }
+    if (lowestAlpha * 255 >= 0.5f) {
+        return true;
+    }
+    bool growsAlpha = m[3] == 0 && m[7] == 0 && m[11] == 0 && m[15] >= 1 && m[19] >= 0;
+    return growsAlpha && m[16] <= 0 && m[17] <= 0 && m[18] <= 0;
+}
+
+// outer(inner(c)) as one matrix
+static GColorMatrix concat(const GColorMatrix& outer, const GColorMatrix& inner) {
+    GColorMatrix result;
+    for (int row = 0; row < 4; ++row) {
+        for (int col = 0; col < 5; ++col) {
+            float sum = col == 4 ? outer[16 + row] : 0;
+            for (int k = 0; k < 4; ++k) {
+                sum += outer[k * 4 + row] * inner[col * 4 + k];
+            }
+            result[col * 4 + row] = sum;
+        }
+    }
+    return result;
+}
+
+std::shared_ptr<GShader> ColorMatrixShader::Make(const GColorMatrix& matrix, GShader* realShader) {
+    if (!realShader) {
+        return nullptr;
+    }
+    if (auto inner = dynamic_cast<ColorMatrixShader*>(realShader)) {
+        if (staysInRange(inner->fMatrix) && keepsColorThroughPremul(inner->fMatrix)) {
+            // A copy owns its real shader, so the fused shader must keep owning it
+            std::shared_ptr<GShader> fused = Make(concat(matrix, inner->fMatrix),
+                                                  inner->fRealShader);
+            if (inner->fOwnedRealShader) {
+                static_cast<ColorMatrixShader*>(fused.get())->fOwnedRealShader =
+                        inner->fOwnedRealShader;
+            }
+            return fused;
+        }
+    }
+    return std::shared_ptr<GShader>(new ColorMatrixShader(matrix, realShader));
+}
+
+ColorMatrixShader::ColorMatrixShader(const GColorMatrix& matrix, GShader* realShader)
+    : fMatrix(matrix), fRealShader(realShader) {
+    if (isIdentity(matrix)) {
+        fKind = kIdentity_Kind;
+    } else if (isPremulLinear(matrix)) {
+        fKind = kPremulLinear_Kind;
+    } else {
+        fKind = kGeneral_Kind;
+    }
+}
+
+bool ColorMatrixShader::isOpaque() {
+    const GColorMatrix& m = fMatrix;
+    bool keepsAlpha = m[3] == 0 && m[7] == 0 && m[11] == 0 && m[15] == 1 && m[19] == 0;
+    bool forcesOpaque = m[3] >= 0 && m[7] >= 0 && m[11] >= 0 && m[15] >= 0 && m[19] >= 1;
+    return forcesOpaque || (keepsAlpha && fRealShader->isOpaque());
+}
+
+// The copy places and shades its own copy of the real shader, which it keeps alive
+std::shared_ptr<GShader> ColorMatrixShader::copy() const {
+    auto copyable = dynamic_cast<const CopyableShader*>(fRealShader);
+    std::shared_ptr<GShader> real = copyable ? copyable->copy() : nullptr;
+    if (!real) {
+        return nullptr;
+    }
+    std::shared_ptr<ColorMatrixShader> result(new ColorMatrixShader(*this));
+    result->fRealShader = real.get();
+    result->fOwnedRealShader = std::move(real);
+    return result;
+}
+
+bool ColorMatrixShader::setContext(const GMatrix& ctm) {
+    return fRealShader->setContext(ctm);
+}
+
+void ColorMatrixShader::shadeRow(int x, int y, int count, GPixel row[]) {
+    fRealShader->shadeRow(x, y, count, row);
+    switch (fKind) {
+        case kIdentity_Kind:     break;
+        case kPremulLinear_Kind: this->shadePremulLinear(count, row); break;
+        case kGeneral_Kind:      this->shadeGeneral(count, row); break;
+    }
+}
+
+#if defined(__SSE2__)
+// Pixels as float lanes in memory order (b, g, r, a), and back with round-half-up
+static inline __m128 loadPixel(GPixel p) {
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(p), _mm_setzero_si128()),
+                                              _mm_setzero_si128()));
+}
+
+static inline GPixel storePixel(__m128 v) {
+    __m128i i = _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(0.5f)));
+    i = _mm_packs_epi32(i, i);
+    return _mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+}
+
+// Column col of the matrix, reordered to the (b, g, r, a) lanes
+static inline __m128 column(const GColorMatrix& m, int col) {
+    return _mm_setr_ps(m[col * 4 + 2], m[col * 4 + 1], m[col * 4 + 0], m[col * 4 + 3]);
+}
+
+#define SPLAT(v, lane) _mm_shuffle_ps(v, v, _MM_SHUFFLE(lane, lane, lane, lane))
+#endif
+
+// Premul in, premul out: the matrix applies to the premul channels directly and clamping to
+// [0, a] is the same as clamping the unpremul result to [0, 1]
+void ColorMatrixShader::shadePremulLinear(int count, GPixel row[]) const {
+#if defined(__SSE2__)
+    const __m128 cr = column(fMatrix, 0), cg = column(fMatrix, 1), cb = column(fMatrix, 2);
+    const __m128 alphaLane = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+    for (int i = 0; i < count; ++i) {
+        __m128 p = loadPixel(row[i]);
+        __m128 a = SPLAT(p, 3);
+        __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cr, SPLAT(p, 2)), _mm_mul_ps(cg, SPLAT(p, 1))),
+                              _mm_mul_ps(cb, SPLAT(p, 0)));
+        v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), a);
+        v = _mm_or_ps(_mm_andnot_ps(alphaLane, v), _mm_and_ps(alphaLane, a));
+        row[i] = storePixel(v);
+    }
+#else
+    const GColorMatrix& m = fMatrix;
+    for (int i = 0; i < count; ++i) {
+        GPixel p = row[i];
+        float a = GPixel_GetA(p), r = GPixel_GetR(p), g = GPixel_GetG(p), b = GPixel_GetB(p);
+        auto channel = [&](int k) {
+            return GRoundToInt(std::min(std::max(m[k] * r + m[4 + k] * g + m[8 + k] * b, 0.0f), a));
+        };
+        row[i] = GPixel_PackARGB(GPixel_GetA(p), channel(0), channel(1), channel(2));
+    }
+#endif
+}
+
+// Unpremul, 4x5 matrix, clamp to [0, 1], premul, all in one register per pixel
+void ColorMatrixShader::shadeGeneral(int count, GPixel row[]) const {
+#if defined(__SSE2__)
+    const __m128 cr = column(fMatrix, 0), cg = column(fMatrix, 1), cb = column(fMatrix, 2),
+                 ca = column(fMatrix, 3), translate = column(fMatrix, 4);
+    const __m128 alphaLane = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+    const __m128 one = _mm_set1_ps(1), scale = _mm_set1_ps(255);
+    for (int i = 0; i < count; ++i) {
+        __m128 p = loadPixel(row[i]);
+        __m128 a = SPLAT(p, 3);
+
+        // rgb / a and a / 255; a == 0 unpremuls to transparent black
+        __m128 divisor = _mm_or_ps(_mm_andnot_ps(alphaLane, _mm_max_ps(a, one)),
+                                   _mm_and_ps(alphaLane, scale));
+        __m128 c = _mm_div_ps(p, divisor);
+
+        __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cr, SPLAT(c, 2)), _mm_mul_ps(cg, SPLAT(c, 1))),
+                              _mm_add_ps(_mm_mul_ps(cb, SPLAT(c, 0)), _mm_mul_ps(ca, SPLAT(c, 3))));
+        v = _mm_min_ps(_mm_max_ps(_mm_add_ps(v, translate), _mm_setzero_ps()), one);
+
+        // premul by the new alpha: rgb * a * 255, a * 255
+        __m128 newA = _mm_mul_ps(SPLAT(v, 3), scale);
+        __m128 factor = _mm_or_ps(_mm_andnot_ps(alphaLane, newA), _mm_and_ps(alphaLane, scale));
+        row[i] = storePixel(_mm_mul_ps(v, factor));
+    }
+#else
+    const GColorMatrix& m = fMatrix;
+    for (int i = 0; i < count; ++i) {
+        GPixel p = row[i];
+        int a = GPixel_GetA(p);
+        float inv = a ? 1.0f / a : 0;
+        float c[4] = {GPixel_GetR(p) * inv, GPixel_GetG(p) * inv, GPixel_GetB(p) * inv, a / 255.0f};
+        float out[4];
+        for (int k = 0; k < 4; ++k) {
+            float v = m[k] * c[0] + m[4 + k] * c[1] + m[8 + k] * c[2] + m[12 + k] * c[3] + m[16 + k];
+            out[k] = std::min(std::max(v, 0.0f), 1.0f);
+        }
+        float newA = out[3] * 255;
+        row[i] = GPixel_PackARGB(GRoundToInt(newA), GRoundToInt(out[0] * newA),
+                                 GRoundToInt(out[1] * newA), GRoundToInt(out[2] * newA));
+    }
+#endif
+}
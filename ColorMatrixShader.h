@@ -0,0 +1,43 @@
+#ifndef COLOR_MATRIX_SHADER_H
+#define COLOR_MATRIX_SHADER_H
+
+#include "include/GFinal.h"
+#include "CopyableShader.h"
+#include <memory>
+
+// Proxies to a real shader and transforms its output by a GColorMatrix, which is defined on
+// unpremul colors, clamping the results. Each row is converted in one pass over the real
+// shader's output. Matrices that keep alpha and only mix r, g and b (scales, grayscale) skip the
+// unpremul/premul entirely, and the identity passes the row through untouched.
+class ColorMatrixShader : public CopyableShader {
+public:
+    // Wrapping another ColorMatrixShader folds the two matrices into one when that can't change
+    // the result: the inner matrix never needs clamping, and premultiplying its output can't
+    // zero the rgb the outer one would see. realShader is not owned.
+    static std::shared_ptr<GShader> Make(const GColorMatrix&, GShader* realShader);
+
+    bool isOpaque() override;
+    bool setContext(const GMatrix& ctm) override;
+    void shadeRow(int x, int y, int count, GPixel row[]) override;
+    std::shared_ptr<GShader> copy() const override;
+
+private:
+    enum Kind {
+        kIdentity_Kind,
+        kPremulLinear_Kind,  // a' = a, rgb' = M * rgb: clamp(M * premul rgb, 0, a) is exact
+        kGeneral_Kind,
+    };
+
+    ColorMatrixShader(const GColorMatrix& matrix, GShader* realShader);
+
+    void shadePremulLinear(int count, GPixel row[]) const;
+    void shadeGeneral(int count, GPixel row[]) const;
+
+    GColorMatrix fMatrix;
+    GShader* fRealShader;
+    // Set in copies, which own their real shader, and in shaders fused from a copy
+    std::shared_ptr<GShader> fOwnedRealShader;
+    Kind fKind;
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef COPYABLE_SHADER_H
+#define COPYABLE_SHADER_H
+
+#include "include/GShader.h"
+#include <memory>
+
+// A shader that can hand out independent copies of itself. ParallelCanvas re-places a mesh's
+// texture per triangle on several workers at once, so each worker shades with its own copy;
+// the shaders in this tree derive from this rather than GShader to allow that.
+class CopyableShader : public GShader {
+public:
+    // A shader that draws the same thing but has its own context, or null if it can't be
+    // copied (e.g. it wraps a shader that isn't a CopyableShader)
+    virtual std::shared_ptr<GShader> copy() const = 0;
+};
+
+#endif
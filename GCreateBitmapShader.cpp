@@ -3,20 +3,164 @@
  */
 
 #include "include/GShader.h"
+#include "CopyableShader.h"
 #include "include/GBitmap.h"
 #include "include/GMatrix.h"
 #include "include/GMath.h"
 #include "my_utils.h"
+#include <cmath>
+#include <mutex>
+#include <vector>
 
-class BitmapShader : public GShader {
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Sample positions are stepped along a row in 32.32 fixed point: the start is mapped once and
+// every later pixel adds the matrix's first column, so a row costs one 2x3 multiply instead of
+// one per pixel, and the stepping error stays far below a texel.
+using Fixed = int64_t;
+constexpr int kFixedShift = 32;
+constexpr double kFixedOne = 4294967296.0;
+
+// Steps one texture axis across a row, keeping the coordinate tiled as it goes. Repeat and
+// mirror keep it inside one period (n or 2n texels) so only a compare-and-subtract is needed
+// per pixel; clamp just clamps the integer texel.
+template <GTileMode kMode> struct AxisStepper {
+    AxisStepper(double start, double step, int n) : fN(n) {
+        if (kMode == GTileMode::kClamp) {
+            // Past these limits every pixel clamps to an edge texel anyway; they keep a row of
+            // up to 2^16 pixels from overflowing the 31 integer bits
+            fPos = static_cast<Fixed>(clampTo(start, 1 << 30) * kFixedOne);
+            fStep = static_cast<Fixed>(clampTo(step, 1 << 14) * kFixedOne);
+            return;
+        }
+
+        double period = kMode == GTileMode::kRepeat ? n : 2.0 * n;
+        fPeriod = static_cast<Fixed>(period) << kFixedShift;
+        fPos = static_cast<Fixed>(wrap(start, period) * kFixedOne);
+        fStep = static_cast<Fixed>(std::fmod(step, period) * kFixedOne);
+        if (fPos >= fPeriod) {
+            fPos -= fPeriod;  // wrap() can land just below period; rounding may carry it over
+        }
+    }
+
+    // Texel index of the current position, and of the texel after it (for bilinear)
+    int index() const { return this->tile(static_cast<int>(fPos >> kFixedShift)); }
+    int nextIndex() const { return this->tile(static_cast<int>(fPos >> kFixedShift) + 1); }
+
+    // Top 8 bits of the position's fraction: the weight of nextIndex()
+    unsigned fraction() const { return static_cast<unsigned>(fPos >> (kFixedShift - 8)) & 0xFF; }
+
+    // i is in [0, period] for repeat and mirror
+    int tile(int i) const {
+        switch (kMode) {
+            case GTileMode::kClamp:
+                return std::min(std::max(i, 0), fN - 1);
+            case GTileMode::kRepeat:
+                return i < fN ? i : 0;
+            case GTileMode::kMirror:
+                i = i < 2 * fN ? i : 0;
+                return i < fN ? i : 2 * fN - 1 - i;
+        }
+        return i;
+    }
+
+    void next() {
+        fPos += fStep;
+        if (kMode != GTileMode::kClamp) {
+            if (fPos >= fPeriod) {
+                fPos -= fPeriod;
+            } else if (fPos < 0) {
+                fPos += fPeriod;
+            }
+        }
+    }
+
+    static double clampTo(double v, double limit) {
+        return std::max(-limit, std::min(v, limit));
+    }
+
+    static double wrap(double v, double period) {
+        return v - std::floor(v / period) * period;
+    }
+
+    Fixed fPos;
+    Fixed fStep;
+    Fixed fPeriod = 0;
+    int   fN;
+};
+
+// Weighted average of a 2x2 block of premul texels; fx and fy (0...255, in 1/256ths) are the
+// weights of the right column and bottom row. Weights sum to 256 on each axis, so the result
+// stays premul and opaque texels stay opaque; the largest partial sum, 255 * 256 + 128, still
+// fits in 16 bits.
+static inline GPixel bilerp(GPixel t00, GPixel t01, GPixel t10, GPixel t11, unsigned fx, unsigned fy) {
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(128);
+
+    // Both columns side by side as 16-bit lanes, [left | right]; blend top and bottom first
+    __m128i top = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(t00), _mm_cvtsi32_si128(t01)), zero);
+    __m128i bottom = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(t10), _mm_cvtsi32_si128(t11)), zero);
+    __m128i column = _mm_add_epi16(_mm_mullo_epi16(top, _mm_set1_epi16(256 - fy)),
+                                   _mm_mullo_epi16(bottom, _mm_set1_epi16(fy)));
+    column = _mm_srli_epi16(_mm_add_epi16(column, half), 8);
+
+    // Weight the left lanes by (256 - fx) and the right by fx, then fold right onto left
+    __m128i wx = _mm_unpacklo_epi64(_mm_set1_epi16(256 - fx), _mm_set1_epi16(fx));
+    __m128i weighted = _mm_mullo_epi16(column, wx);
+    __m128i sum = _mm_add_epi16(weighted, _mm_srli_si128(weighted, 8));
+    sum = _mm_srli_epi16(_mm_add_epi16(sum, half), 8);
+    return _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+#else
+    // Two channels per multiply: masking with 0x00FF00FF leaves each channel 16 bits of room
+    auto lerp = [](uint32_t a, uint32_t b, unsigned w) {
+        uint32_t rb = ((a & 0x00FF00FF) * (256 - w) + (b & 0x00FF00FF) * w + 0x00800080) >> 8;
+        uint32_t ag = ((a >> 8) & 0x00FF00FF) * (256 - w) + ((b >> 8) & 0x00FF00FF) * w + 0x00800080;
+        return (rb & 0x00FF00FF) | (ag & 0xFF00FF00);
+    };
+    return lerp(lerp(t00, t10, fy), lerp(t01, t11, fy), fx);
+#endif
+}
+
+// One mip level: the pixels of a bitmap shrunk by half (rounding up) with a 2x2 box filter
+static std::vector<GPixel> downsample(const GBitmap& src, int width, int height) {
+    std::vector<GPixel> pixels(static_cast<size_t>(width) * height);
+    for (int y = 0; y < height; ++y) {
+        const GPixel* row0 = src.getAddr(0, std::min(2 * y, src.height() - 1));
+        const GPixel* row1 = src.getAddr(0, std::min(2 * y + 1, src.height() - 1));
+        for (int x = 0; x < width; ++x) {
+            int x0 = std::min(2 * x, src.width() - 1);
+            int x1 = std::min(2 * x + 1, src.width() - 1);
+            GPixel result = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                unsigned sum = ((row0[x0] >> shift) & 0xFF) + ((row0[x1] >> shift) & 0xFF) +
+                               ((row1[x0] >> shift) & 0xFF) + ((row1[x1] >> shift) & 0xFF);
+                result |= ((sum + 2) >> 2) << shift;
+            }
+            pixels[static_cast<size_t>(y) * width + x] = result;
+        }
+    }
+    return pixels;
+}
+
+class BitmapShader : public CopyableShader {
 public:
-    BitmapShader(const GBitmap& bitmap, const GMatrix& localMatrix, GTileMode tileMode)
-        : fBitmap(bitmap), fLocalMatrix(localMatrix), fTileMode(tileMode) {}
+    BitmapShader(const GBitmap& bitmap, const GMatrix& localMatrix, GTileMode tileMode,
+                 GFilterQuality quality)
+        : fBitmap(bitmap), fLocalMatrix(localMatrix), fTileMode(tileMode), fQuality(quality),
+          fMips(std::make_shared<MipCache>()) {}
 
     bool isOpaque() override {
         return fBitmap.isOpaque();  // Check if all pixels in the bitmap are opaque
     }
 
+    // Copies share the mip levels, built by whichever of them first needs each one
+    std::shared_ptr<GShader> copy() const override {
+        return std::make_shared<BitmapShader>(*this);
+    }
+
     bool setContext(const GMatrix& ctm) override {
         // Combine the local matrix with the current transformation matrix (CTM)
         fCTM = GMatrix::Concat(ctm, fLocalMatrix);
@@ -30,56 +174,206 @@ public:
 
         // Store the inverted matrix for shading use
         fInverseCTM = invCTM.value();
+
+        // Pick the bitmap to sample: a mip level when minified, mapped into that level's texels
+        fSource = fBitmap;
+        fSourceInverse = fInverseCTM;
+        if (fQuality == GFilterQuality::kMipmap) {
+            int level = this->chooseLevel();
+            if (level > 0) {
+                fSource = this->mipLevel(level);
+                float sx = static_cast<float>(fSource.width()) / fBitmap.width();
+                float sy = static_cast<float>(fSource.height()) / fBitmap.height();
+                fSourceInverse = GMatrix::Concat(GMatrix::Scale(sx, sy), fInverseCTM);
+            }
+        }
+
+        // Pick the row loop the matrix allows
+        if (fSourceInverse[1] != 0 || fSourceInverse[2] != 0) {
+            fMatrixKind = kAffine_Kind;
+        } else if (fSourceInverse[0] != 1 || fSourceInverse[3] != 1) {
+            fMatrixKind = kScaleTranslate_Kind;
+        } else {
+            fMatrixKind = kTranslate_Kind;
+        }
         return true;
     }
 
     void shadeRow(int x, int y, int count, GPixel row[]) override {
-        for (int i = 0; i < count; ++i) {
-            // Map the device space (x, y) to the bitmap space using the inverse CTM
-            GPoint devicePoint = {static_cast<float>(x + i)+0.5, static_cast<float>(y)+0.5};
-            GPoint bitmapPoint;
-            fInverseCTM.mapPoints(&bitmapPoint, &devicePoint, 1);
-
-            // int bx = static_cast<int>(bitmapPoint.x) % fBitmap.width();  // Wrap around for tiling
-            // int by = static_cast<int>(bitmapPoint.y) % fBitmap.height();
-            float bx, by;
+        if (fQuality == GFilterQuality::kNearest) {
+            switch (fTileMode) {
+                case GTileMode::kClamp:  this->shadeRowTiled<GTileMode::kClamp>(x, y, count, row);  break;
+                case GTileMode::kRepeat: this->shadeRowTiled<GTileMode::kRepeat>(x, y, count, row); break;
+                case GTileMode::kMirror: this->shadeRowTiled<GTileMode::kMirror>(x, y, count, row); break;
+            }
+        } else {
             switch (fTileMode) {
-                case GTileMode::kClamp:
-                    bx = tileClamp(bitmapPoint.x, fBitmap.width() - 1);
-                    by = tileClamp(bitmapPoint.y, fBitmap.height() - 1);
-                    break;
-                case GTileMode::kRepeat:
-                    bx = tileRepeat(bitmapPoint.x, fBitmap.width());
-                    by = tileRepeat(bitmapPoint.y, fBitmap.height());
-                    break;
-                case GTileMode::kMirror:
-                    bx = tileMirror(bitmapPoint.x, fBitmap.width());
-                    by = tileMirror(bitmapPoint.y, fBitmap.height());
-                    break;
+                case GTileMode::kClamp:  this->shadeRowBilinear<GTileMode::kClamp>(x, y, count, row);  break;
+                case GTileMode::kRepeat: this->shadeRowBilinear<GTileMode::kRepeat>(x, y, count, row); break;
+                case GTileMode::kMirror: this->shadeRowBilinear<GTileMode::kMirror>(x, y, count, row); break;
             }
+        }
+    }
+
+private:
+    enum MatrixKind {
+        kTranslate_Kind,        // Rows map to whole texels, one texel per pixel
+        kScaleTranslate_Kind,   // Rows stay on one texture row
+        kAffine_Kind,           // Both texture coordinates change along a row
+    };
 
-            if (bx < 0) bx += fBitmap.width();  // Ensure positive indices
-            if (by < 0) by += fBitmap.height();
+    template <GTileMode kMode> void shadeRowTiled(int x, int y, int count, GPixel row[]) const {
+        // Map the first pixel center the same way mapPoints() does for any single point
+        const GMatrix& inv = fSourceInverse;
+        GPoint start = {x + 0.5f, y + 0.5f};
+        inv.mapPoints(&start, &start, 1);
+        double u = start.x;
+        double v = start.y;
 
-            // Set the pixel color
-            // row[i] = *fBitmap.getAddr(GRoundToInt(bx), GRoundToInt(by));
-            row[i] = *fBitmap.getAddr(static_cast<int>(bx), static_cast<int>(by));
+        AxisStepper<kMode> su(u, inv[0], fSource.width());
+        if (fMatrixKind != kAffine_Kind) {
+            // The texture row is the same for the whole span
+            AxisStepper<kMode> sv(v, 0, fSource.height());
+            const GPixel* src = fSource.getAddr(0, sv.index());
+            if (fMatrixKind == kTranslate_Kind && kMode == GTileMode::kRepeat) {
+                copyRepeat(src, su.index(), count, row);
+                return;
+            }
+            for (int i = 0; i < count; ++i) {
+                row[i] = src[su.index()];
+                su.next();
+            }
+            return;
+        }
 
+        AxisStepper<kMode> sv(v, inv[1], fSource.height());
+        const GPixel* pixels = fSource.pixels();
+        size_t stride = fSource.rowBytes() >> 2;
+        for (int i = 0; i < count; ++i) {
+            row[i] = pixels[sv.index() * stride + su.index()];
+            su.next();
+            sv.next();
         }
     }
 
-private:
+    // Same stepping as shadeRowTiled, but offset by half a texel so the integer part picks the
+    // top-left of the 2x2 block around the sample and the fraction gives the blend weights
+    template <GTileMode kMode> void shadeRowBilinear(int x, int y, int count, GPixel row[]) const {
+        const GMatrix& inv = fSourceInverse;
+        GPoint start = {x + 0.5f, y + 0.5f};
+        inv.mapPoints(&start, &start, 1);
+
+        AxisStepper<kMode> su(start.x - 0.5, inv[0], fSource.width());
+        if (fMatrixKind != kAffine_Kind) {
+            // Both texture rows and their weight are the same for the whole span
+            AxisStepper<kMode> sv(start.y - 0.5, 0, fSource.height());
+            const GPixel* row0 = fSource.getAddr(0, sv.index());
+            const GPixel* row1 = fSource.getAddr(0, sv.nextIndex());
+            unsigned fy = sv.fraction();
+            for (int i = 0; i < count; ++i) {
+                int x0 = su.index();
+                int x1 = su.nextIndex();
+                row[i] = bilerp(row0[x0], row0[x1], row1[x0], row1[x1], su.fraction(), fy);
+                su.next();
+            }
+            return;
+        }
+
+        AxisStepper<kMode> sv(start.y - 0.5, inv[1], fSource.height());
+        const GPixel* pixels = fSource.pixels();
+        size_t stride = fSource.rowBytes() >> 2;
+        for (int i = 0; i < count; ++i) {
+            const GPixel* row0 = pixels + sv.index() * stride;
+            const GPixel* row1 = pixels + sv.nextIndex() * stride;
+            int x0 = su.index();
+            int x1 = su.nextIndex();
+            row[i] = bilerp(row0[x0], row0[x1], row1[x0], row1[x1], su.fraction(), sv.fraction());
+            su.next();
+            sv.next();
+        }
+    }
+
+    // The level whose texels are closest to (but not smaller than) one device pixel, judged by
+    // the longer of the two texture-space steps of a device pixel
+    int chooseLevel() const {
+        const GMatrix& inv = fInverseCTM;
+        float dx = inv[0] * inv[0] + inv[1] * inv[1];
+        float dy = inv[2] * inv[2] + inv[3] * inv[3];
+        float texelsPerPixel = std::sqrt(std::max(dx, dy));
+
+        int level = 0;
+        int width = fBitmap.width();
+        int height = fBitmap.height();
+        while (texelsPerPixel >= 2 && (width > 1 || height > 1)) {
+            texelsPerPixel *= 0.5f;
+            width = (width + 1) / 2;
+            height = (height + 1) / 2;
+            ++level;
+        }
+        return level;
+    }
+
+    // Builds levels up to the requested one on first use. Called only from setContext(), so
+    // shading never touches the cache; the lock is for copies placed on other threads. A level's
+    // pixels never move once built, so the returned bitmap stays valid after unlocking.
+    GBitmap mipLevel(int level) {
+        std::lock_guard<std::mutex> lock(fMips->mutex);
+        std::vector<MipLevel>& levels = fMips->levels;
+        if (levels.empty()) {
+            levels.push_back({fBitmap, {}});
+        }
+        while (static_cast<int>(levels.size()) <= level) {
+            const GBitmap& prev = levels.back().bitmap;
+            int width = (prev.width() + 1) / 2;
+            int height = (prev.height() + 1) / 2;
+            MipLevel next;
+            next.pixels = downsample(prev, width, height);
+            next.bitmap = GBitmap(width, height, width * sizeof(GPixel), next.pixels.data(),
+                                  fBitmap.isOpaque());
+            levels.push_back(std::move(next));
+        }
+        return levels[level].bitmap;
+    }
+
+    // One texel per pixel: copy whole runs of the texture row, wrapping at its end
+    void copyRepeat(const GPixel src[], int start, int count, GPixel row[]) const {
+        int width = fBitmap.width();
+        while (count > 0) {
+            int n = std::min(count, width - start);
+            std::copy(src + start, src + start + n, row);
+            row += n;
+            count -= n;
+            start = 0;
+        }
+    }
+
+    struct MipLevel {
+        GBitmap             bitmap;
+        std::vector<GPixel> pixels;  // Owns bitmap's pixels (empty for level 0)
+    };
+
+    struct MipCache {
+        std::mutex            mutex;
+        std::vector<MipLevel> levels;  // Built lazily; [0] is fBitmap
+    };
+
     GBitmap fBitmap;
     GMatrix fLocalMatrix;
     GMatrix fCTM;          // Store the forward transformation
     GMatrix fInverseCTM;    // Store the inverse transformation
+    GBitmap fSource;        // The bitmap or mip level being sampled
+    GMatrix fSourceInverse; // Device to fSource texels
+    MatrixKind fMatrixKind = kAffine_Kind;
     GTileMode fTileMode;
+    GFilterQuality fQuality;
+    std::shared_ptr<MipCache> fMips;  // Shared with copies
 };
 
 // Factory function for creating the bitmap shader
-std::shared_ptr<GShader> GCreateBitmapShader(const GBitmap& bitmap, const GMatrix& localMatrix, GTileMode tileMode) {
+std::shared_ptr<GShader> GCreateBitmapShader(const GBitmap& bitmap, const GMatrix& localMatrix, GTileMode tileMode,
+                                             GFilterQuality quality) {
     if (!bitmap.pixels()) {
         return nullptr;  // Return null if bitmap is invalid
     }
-    return std::shared_ptr<GShader>(new BitmapShader(bitmap, localMatrix, tileMode));
+    return std::shared_ptr<GShader>(new BitmapShader(bitmap, localMatrix, tileMode, quality));
 }
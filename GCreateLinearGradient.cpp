@@ -1,15 +1,41 @@
 #include "include/GShader.h"
+#include "CopyableShader.h"
 #include "include/GMatrix.h"
 #include "include/GPixel.h"
 #include "include/GColor.h"
 #include "my_utils.h"
+#include <algorithm>
 #include <vector>
 #include <cmath>
 
-class LinearGradientShader : public GShader {
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Minimum resolution of the color table: fine enough that neighboring entries of a two-color
+// ramp differ by less than one 8-bit step. Evenly spaced stops round it up so every stop lands
+// on an entry; the table is only used when they all do, and other gradients are evaluated
+// exactly per pixel.
+static constexpr int kLutSize = 1024;
+
+class LinearGradientShader : public CopyableShader {
 public:
-    LinearGradientShader(GPoint p0, GPoint p1, const GColor colors[], int count, GTileMode tileMode)
-        : fP0(p0), fP1(p1), fColors(colors, colors + count), fColorCount(count), fTileMode(tileMode) {}
+    // pos may be null, meaning the colors are evenly spaced. Positions are pinned to [0, 1] and
+    // raised to the one before where they would decrease (NaN counts as decreasing).
+    LinearGradientShader(GPoint p0, GPoint p1, const GColor colors[], const float pos[], int count,
+                         GTileMode tileMode)
+        : fP0(p0), fP1(p1), fColors(colors, colors + count), fColorCount(count), fTileMode(tileMode) {
+        fPositions.resize(count);
+        float previous = 0;
+        for (int i = 0; i < count; ++i) {
+            float p = pos ? pos[i] : (count > 1 ? static_cast<float>(i) / (count - 1) : 0);
+            previous = p >= previous ? std::min(p, 1.0f) : previous;
+            fPositions[i] = previous;
+        }
+        int segments = std::max(count - 1, 1);
+        fLastEntry = pos ? kLutSize - 1 : segments * ((kLutSize - 1 + segments - 1) / segments);
+        fUseLut = this->stopsOnLutEntries();
+    }
 
     bool isOpaque() override {
         // Check if all colors are opaque
@@ -21,6 +47,10 @@ public:
         return true;
     }
 
+    std::shared_ptr<GShader> copy() const override {
+        return std::make_shared<LinearGradientShader>(*this);
+    }
+
    bool setContext(const GMatrix& ctm) override {
         GPoint u = fP1 - fP0; // vector
         GPoint v = {u.y, -u.x}; // perp vector
@@ -35,63 +65,190 @@ public:
         }
 
         fInverseMatrix = invCTM.value();
+
+        // The colors never change, so the table is built by the first draw and reused after
+        if (fUseLut && fLut.empty()) {
+            this->buildLut();
+        }
         return true;
     }
 
-   void shadeRow(int x, int y, int count, GPixel row[]) override {
-        for (int i = 0; i < count; ++i) {
-            GPoint pt = { static_cast<float>(x + i)+0.5, static_cast<float>(y)+0.5 };
-            fInverseMatrix.mapPoints(&pt, &pt, 1);
-
-            float t = pt.x;  // Use transformed x coordinate as 't' for the gradient
-
-            switch (fTileMode) {
-                case GTileMode::kClamp:
-                    t = std::max(0.0f, std::min(t, 1.0f));
-                    break;
-                case GTileMode::kRepeat:
-                    t = tileRepeat(t, 1.0f);
-                    break;
-                case GTileMode::kMirror:
-                    t = tileMirror(t, 1.0f);
-                    break;
+    // t is affine in device x, so a row is its start plus i steps of the matrix's first
+    // column; each t is tiled into [0, 1] and scaled straight to a table index
+    void shadeRow(int x, int y, int count, GPixel row[]) override {
+        GPoint start = {x + 0.5f, y + 0.5f};
+        fInverseMatrix.mapPoints(&start, &start, 1);
+        float t0 = start.x;
+        float dt = fInverseMatrix[0];
+
+        if (!fUseLut) {
+            // Neighboring pixels usually share a segment, so each search starts from the last
+            int stop = 0;
+            for (int i = 0; i < count; ++i) {
+                row[i] = this->exactColor(this->tile(t0 + i * dt), &stop);
             }
+            return;
+        }
 
-            // Interpolate between the colors based on t
-            int index = static_cast<int>(t * (fColorCount - 1));
-            float localT = (t * (fColorCount - 1)) - index;
+        int i = 0;
+#if defined(__SSE2__)
+        const __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+        for (; i + 4 <= count; i += 4) {
+            __m128 t = _mm_add_ps(_mm_set1_ps(t0), _mm_mul_ps(_mm_add_ps(_mm_set1_ps(i), lane), _mm_set1_ps(dt)));
+            alignas(16) int index[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(index), this->lutIndex(this->tile(t)));
+            row[i + 0] = fLut[index[0]];
+            row[i + 1] = fLut[index[1]];
+            row[i + 2] = fLut[index[2]];
+            row[i + 3] = fLut[index[3]];
+        }
+#endif
+        for (; i < count; ++i) {
+            row[i] = fLut[this->lutIndex(this->tile(t0 + i * dt))];
+        }
+    }
 
-           // Ensure index doesn't exceed bounds
-            GColor c0 = fColors[index];
-            GColor c1 = fColors[std::min(index + 1, fColorCount - 1)];
 
-            GColor color = {
-                c0.r * (1 - localT) + c1.r * localT,
-                c0.g * (1 - localT) + c1.g * localT,
-                c0.b * (1 - localT) + c1.b * localT,
-                c0.a * (1 - localT) + c1.a * localT
-            };
+private:
+    // True if every stop sits exactly on a table entry, and no two share one. A pixel on a stop
+    // then reads that stop's own color, and no segment is narrower than an entry.
+    bool stopsOnLutEntries() const {
+        int previous = -1;
+        for (float p : fPositions) {
+            int entry = static_cast<int>(std::lround(p * fLastEntry));
+            if (entry <= previous || static_cast<float>(entry) / fLastEntry != p) {
+                return false;
+            }
+            previous = entry;
+        }
+        return true;
+    }
 
-            // Premultiply the color and convert it to a pixel
-            row[i] = ColorToPixel(color.pinToUnit());
+    // The premultiplied color at t, interpolated inside the segment that holds it. *stop is a
+    // starting guess for that segment, and is left at the one found. A t on a hard edge takes
+    // the color after it; t before the first stop or after the last takes that stop's color.
+    GPixel exactColor(float t, int* stop) const {
+        t = std::max(0.0f, std::min(t, 1.0f));  // Pins NaN to 0 too
+        int s = *stop;
+        bool inside = fPositions[s] <= t && (s + 1 == fColorCount || t < fPositions[s + 1]);
+        if (!inside) {
+            s = static_cast<int>(std::upper_bound(fPositions.begin(), fPositions.end(), t) -
+                                 fPositions.begin()) - 1;
+            s = std::max(s, 0);
+            *stop = s;
         }
+
+        if (s + 1 == fColorCount || t <= fPositions[s]) {
+            return ColorToPixel(fColors[s].pinToUnit());
+        }
+        const GColor& c0 = fColors[s];
+        const GColor& c1 = fColors[s + 1];
+        float localT = (t - fPositions[s]) / (fPositions[s + 1] - fPositions[s]);
+        GColor color = {
+            c0.r * (1 - localT) + c1.r * localT,
+            c0.g * (1 - localT) + c1.g * localT,
+            c0.b * (1 - localT) + c1.b * localT,
+            c0.a * (1 - localT) + c1.a * localT
+        };
+        return ColorToPixel(color.pinToUnit());
     }
 
+    // Entry i holds the premultiplied color at t = i / fLastEntry. Entries are visited in
+    // increasing t, so the stop they fall between only ever moves forward; t before the first
+    // stop or after the last takes that stop's color.
+    void buildLut() {
+        fLut.resize(fLastEntry + 1);
+        int stop = 0;
+        for (int i = 0; i <= fLastEntry; ++i) {
+            float t = static_cast<float>(i) / fLastEntry;
+            while (stop + 1 < fColorCount && fPositions[stop + 1] <= t) {
+                ++stop;
+            }
+
+            GColor color = fColors[stop];
+            if (stop + 1 < fColorCount && t > fPositions[stop]) {
+                const GColor& c0 = fColors[stop];
+                const GColor& c1 = fColors[stop + 1];
+                float localT = (t - fPositions[stop]) / (fPositions[stop + 1] - fPositions[stop]);
+                color = {
+                    c0.r * (1 - localT) + c1.r * localT,
+                    c0.g * (1 - localT) + c1.g * localT,
+                    c0.b * (1 - localT) + c1.b * localT,
+                    c0.a * (1 - localT) + c1.a * localT
+                };
+            }
+            fLut[i] = ColorToPixel(color.pinToUnit());
+        }
+    }
+
+    float tile(float t) const {
+        switch (fTileMode) {
+            case GTileMode::kClamp:  return t;  // lutIndex() and exactColor() pin it
+            case GTileMode::kRepeat: return tileRepeat(t, 1.0f);
+            case GTileMode::kMirror: return tileMirror(t, 1.0f);
+        }
+        return t;
+    }
+
+    // Pinned before converting, so NaN, huge and out-of-range values still land in the table
+    int lutIndex(float t) const {
+        float index = t * fLastEntry + 0.5f;
+        return static_cast<int>(std::max(0.0f, std::min(index, static_cast<float>(fLastEntry))));
+    }
+
+#if defined(__SSE2__)
+    static __m128 floor(__m128 v) {
+        __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+        return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, v), _mm_set1_ps(1)));
+    }
+
+    __m128 tile(__m128 t) const {
+        switch (fTileMode) {
+            case GTileMode::kClamp:
+                return t;
+            case GTileMode::kRepeat:
+                return _mm_sub_ps(t, floor(t));
+            case GTileMode::kMirror: {
+                // |((t - 1) mod 2) - 1| folds every other period back onto [0, 1]
+                __m128 w = _mm_sub_ps(t, _mm_set1_ps(1));
+                w = _mm_sub_ps(w, _mm_mul_ps(_mm_set1_ps(2), floor(_mm_mul_ps(w, _mm_set1_ps(0.5f)))));
+                w = _mm_sub_ps(w, _mm_set1_ps(1));
+                return _mm_andnot_ps(_mm_set1_ps(-0.0f), w);
+            }
+        }
+        return t;
+    }
+
+    __m128i lutIndex(__m128 t) const {
+        __m128 last = _mm_set1_ps(static_cast<float>(fLastEntry));
+        __m128 index = _mm_add_ps(_mm_mul_ps(t, last), _mm_set1_ps(0.5f));
+        index = _mm_min_ps(_mm_max_ps(index, _mm_setzero_ps()), last);
+        return _mm_cvttps_epi32(index);
+    }
+#endif
 
-private:
     GPoint fP0, fP1;
     std::vector<GColor> fColors;
+    std::vector<float> fPositions;  // Non-decreasing and within [0, 1], one per color
     int fColorCount;
     GMatrix fLocalMatrix;
     GMatrix fInverseMatrix;
     GMatrix fCTM;
     GTileMode fTileMode;
+    int fLastEntry;  // The table has fLastEntry + 1 entries
+    bool fUseLut;
+    std::vector<GPixel> fLut;
 };
 
 // Factory function to create the linear gradient shader
 std::shared_ptr<GShader> GCreateLinearGradient(GPoint p0, GPoint p1, const GColor colors[], int count, GTileMode tileMode) {
+    return GCreateLinearGradient(p0, p1, colors, nullptr, count, tileMode);
+}
+
+std::shared_ptr<GShader> GCreateLinearGradient(GPoint p0, GPoint p1, const GColor colors[], const float pos[],
+                                               int count, GTileMode tileMode) {
     if (count < 1) {
         return nullptr;
     }
-    return std::make_shared<LinearGradientShader>(p0, p1, colors, count, tileMode);
-}
\ No newline at end of file
+    return std::make_shared<LinearGradientShader>(p0, p1, colors, pos, count, tileMode);
+}
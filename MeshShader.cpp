@@ -0,0 +1,55 @@
+#include "MeshShader.h"
+#include "my_utils.h"
+
+static const GPoint kNoPoints[3] = {};
+static const GColor kNoColors[3] = {};
+
+MeshShader::MeshShader(GShader* texture, bool hasColors)
+    : fTexture(texture), fHasColors(hasColors), fColors(kNoPoints, kNoColors) {}
+
+void MeshShader::setTriangle(const GPoint pts[3], const GColor cols[3], const GPoint texs[3]) {
+    if (fHasColors) {
+        fColors = TriColorShader(pts, cols);
+    }
+    if (fTexture) {
+        fTexToLocal = calculateTextureTransform(texs[0], texs[1], texs[2], pts[0], pts[1], pts[2]);
+    }
+}
+
+bool MeshShader::isOpaque() {
+    return (!fHasColors || fColors.isOpaque()) && (!fTexture || fTexture->isOpaque());
+}
+
+bool MeshShader::setContext(const GMatrix& ctm) {
+    if (fHasColors && !fColors.setContext(ctm)) {
+        return false;
+    }
+    return !fTexture || fTexture->setContext(ctm * fTexToLocal);
+}
+
+void MeshShader::shadeRow(int x, int y, int count, GPixel row[]) {
+    if (!fTexture) {
+        fColors.shadeRow(x, y, count, row);
+        return;
+    }
+    fTexture->shadeRow(x, y, count, row);
+    if (!fHasColors) {
+        return;
+    }
+
+    // Modulate the texture by the colors, a chunk at a time through a stack buffer so that
+    // concurrent bands never share scratch space
+    GPixel colors[256];
+    for (int done = 0; done < count; done += 256) {
+        int n = std::min(count - done, 256);
+        fColors.shadeRow(x + done, y, n, colors);
+        for (int i = 0; i < n; ++i) {
+            GPixel t = row[done + i];
+            GPixel c = colors[i];
+            row[done + i] = GPixel_PackARGB(divide255(GET_ALPHA(t) * GET_ALPHA(c)),
+                                            divide255(GET_RED(t) * GET_RED(c)),
+                                            divide255(GET_GREEN(t) * GET_GREEN(c)),
+                                            divide255(GET_BLUE(t) * GET_BLUE(c)));
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef MESH_SHADER_H
+#define MESH_SHADER_H
+
+#include "include/GShader.h"
+#include "include/GMatrix.h"
+#include "TriColorShader.h"
+
+// Shades one mesh triangle at a time: interpolated vertex colors, the paint's shader mapped
+// through the triangle's texture coordinates, or both multiplied together. drawMesh keeps a
+// single instance per band and re-points it at each triangle with setTriangle(), so no
+// shaders are created per triangle.
+class MeshShader : public GShader {
+    GShader* fTexture;      // The paint's shader, or null when texs are not used
+    bool fHasColors;
+    TriColorShader fColors; // Valid when fHasColors
+    GMatrix fTexToLocal;    // Texture space to the triangle's local space
+
+public:
+    MeshShader(GShader* texture, bool hasColors);
+
+    // pts are in local space; cols and texs are ignored when the mesh has none
+    void setTriangle(const GPoint pts[3], const GColor cols[3], const GPoint texs[3]);
+
+    bool isOpaque() override;
+    bool setContext(const GMatrix& ctm) override;
+    void shadeRow(int x, int y, int count, GPixel row[]) override;
+};
+
+#endif
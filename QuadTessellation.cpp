@@ -0,0 +1,177 @@
+#include "QuadTessellation.h"
+#include "my_utils.h"
+
+// Writes the quadratic bezier p0, p1, p2 at t = 0, 1/n, ... 1 by forward differencing: with
+// B(t) = a t^2 + b t + p0, each point is the previous plus a first difference that itself
+// grows by the constant second difference 2 a h^2. The end is pinned to p2 so rounding
+// can't leave a gap between patches that share it.
+static void forwardDifferenceQuad(GPoint p0, GPoint p1, GPoint p2, int n, GPoint out[]) {
+    float h = 1.0f / n;
+    GPoint a = p0 - 2 * p1 + p2;
+    GPoint b = 2 * (p1 - p0);
+    GPoint d1 = a * (h * h) + b * h;
+    GPoint d2 = a * (2 * h * h);
+
+    GPoint p = p0;
+    for (int i = 0; i < n; ++i) {
+        out[i] = p;
+        p += d1;
+        d1 += d2;
+    }
+    out[n] = p2;
+}
+
+const QuadTessellation::Grid& QuadTessellation::grid(int level) {
+    auto found = fGrids.find(level);
+    if (found != fGrids.end()) {
+        return found->second;
+    }
+
+    int n = level + 1;  // Cells per side
+    Grid& grid = fGrids[level];
+    grid.steps.resize(n + 1);
+    for (int i = 0; i <= n; ++i) {
+        grid.steps[i] = i * (1.0f / n);
+    }
+
+    grid.indices.reserve(static_cast<size_t>(n) * n * 6);
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            int topLeft = y * (n + 1) + x;
+            int topRight = topLeft + 1;
+            int bottomLeft = topLeft + (n + 1);
+            int bottomRight = bottomLeft + 1;
+            grid.indices.insert(grid.indices.end(), {topLeft, topRight, bottomRight,
+                                                     topLeft, bottomRight, bottomLeft});
+        }
+    }
+    return grid;
+}
+
+// Each point is lerp(top(u), bottom(u), v). The top and bottom edges are evaluated once per
+// column, which leaves one lerp per vertex for each attribute.
+bool QuadTessellation::evaluate(const GPoint verts[4], const GColor colors[4], const GPoint texs[4],
+                                int level) {
+    if (level < 0) {
+        return false;
+    }
+    fGrid = &this->grid(level);
+    const std::vector<float>& steps = fGrid->steps;
+    int side = static_cast<int>(steps.size());
+    size_t count = static_cast<size_t>(side) * side;
+
+    fTopVerts.resize(side);
+    fBottomVerts.resize(side);
+    fVerts.resize(count);
+    for (int x = 0; x < side; ++x) {
+        fTopVerts[x] = lerp(verts[0], verts[1], steps[x]);
+        fBottomVerts[x] = lerp(verts[3], verts[2], steps[x]);
+    }
+    for (int y = 0; y < side; ++y) {
+        GPoint* row = fVerts.data() + static_cast<size_t>(y) * side;
+        for (int x = 0; x < side; ++x) {
+            row[x] = lerp(fTopVerts[x], fBottomVerts[x], steps[y]);
+        }
+    }
+
+    if (colors) {
+        fTopColors.resize(side);
+        fBottomColors.resize(side);
+        fColors.resize(count);
+        for (int x = 0; x < side; ++x) {
+            fTopColors[x] = lerpColor(colors[0], colors[1], steps[x]);
+            fBottomColors[x] = lerpColor(colors[3], colors[2], steps[x]);
+        }
+        for (int y = 0; y < side; ++y) {
+            GColor* row = fColors.data() + static_cast<size_t>(y) * side;
+            for (int x = 0; x < side; ++x) {
+                row[x] = lerpColor(fTopColors[x], fBottomColors[x], steps[y]);
+            }
+        }
+    }
+
+    if (texs) {
+        this->evaluateTexs(texs);
+    }
+    return true;
+}
+
+void QuadTessellation::evaluateTexs(const GPoint texs[4]) {
+    const std::vector<float>& steps = fGrid->steps;
+    int side = static_cast<int>(steps.size());
+
+    fTopTexs.resize(side);
+    fBottomTexs.resize(side);
+    fTexs.resize(static_cast<size_t>(side) * side);
+    for (int x = 0; x < side; ++x) {
+        fTopTexs[x] = lerp(texs[0], texs[1], steps[x]);
+        fBottomTexs[x] = lerp(texs[3], texs[2], steps[x]);
+    }
+    for (int y = 0; y < side; ++y) {
+        GPoint* row = fTexs.data() + static_cast<size_t>(y) * side;
+        for (int x = 0; x < side; ++x) {
+            row[x] = lerp(fTopTexs[x], fBottomTexs[x], steps[y]);
+        }
+    }
+}
+
+// value(u, v) = TB(u, v) + LR(u, v) - Corners(u, v). The boundary curves are forward
+// differenced once per grid line. Down a column, TB - Corners is linear in v, and along a
+// row, LR is linear in u, so after that setup each vertex is two running sums and an add.
+// The outer rows and columns are the boundary curves themselves, so they (and the corners)
+// are copied exactly rather than left to the sums' rounding, like forwardDifferenceQuad's
+// end; patches that share an edge then share its vertices bit for bit.
+bool QuadTessellation::evaluateCoons(const GPoint pts[8], const GPoint texs[4], int level) {
+    if (level < 0) {
+        return false;
+    }
+    fGrid = &this->grid(level);
+    int n = level + 1;
+    int side = n + 1;
+
+    fTopVerts.resize(side);
+    fBottomVerts.resize(side);
+    fLeftVerts.resize(side);
+    fRightVerts.resize(side);
+    fColumns.resize(side);
+    fColumnSteps.resize(side);
+    fVerts.resize(static_cast<size_t>(side) * side);
+    forwardDifferenceQuad(pts[0], pts[1], pts[2], n, fTopVerts.data());
+    forwardDifferenceQuad(pts[6], pts[5], pts[4], n, fBottomVerts.data());
+    forwardDifferenceQuad(pts[0], pts[7], pts[6], n, fLeftVerts.data());
+    forwardDifferenceQuad(pts[2], pts[3], pts[4], n, fRightVerts.data());
+
+    // Each column's (TB - Corners) at v = 0 and its step per row. The corner term's top and
+    // bottom edges are the chords 0-2 and 6-4.
+    float h = 1.0f / n;
+    for (int x = 0; x < side; ++x) {
+        float u = x * h;
+        GPoint top = fTopVerts[x] - lerp(pts[0], pts[2], u);
+        GPoint bottom = fBottomVerts[x] - lerp(pts[6], pts[4], u);
+        fColumns[x] = top;
+        fColumnSteps[x] = (bottom - top) * h;
+    }
+
+    for (int y = 0; y < side; ++y) {
+        GPoint* row = fVerts.data() + static_cast<size_t>(y) * side;
+        if (y == 0 || y == n) {
+            const GPoint* edge = y == 0 ? fTopVerts.data() : fBottomVerts.data();
+            std::copy(edge, edge + side, row);
+            continue;
+        }
+        GPoint lr = fLeftVerts[y];
+        GPoint lrStep = (fRightVerts[y] - fLeftVerts[y]) * h;
+        for (int x = 0; x < side; ++x) {
+            fColumns[x] += fColumnSteps[x];
+            row[x] = fColumns[x] + lr;
+            lr += lrStep;
+        }
+        row[0] = fLeftVerts[y];
+        row[n] = fRightVerts[y];
+    }
+
+    if (texs) {
+        this->evaluateTexs(texs);
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef QUAD_TESSELLATION_H
+#define QUAD_TESSELLATION_H
+
+#include "include/GColor.h"
+#include "include/GPoint.h"
+#include <map>
+#include <vector>
+
+// Tessellates quads into a shared-vertex triangle mesh for drawMesh. The parametric grid and
+// the triangle indices depend only on the level, so they are built once per level and kept;
+// each quad then only evaluates its corners over the grid, into buffers that are reused from
+// call to call and only grow when a larger level is first seen.
+//
+// A level L quad is an (L + 1) x (L + 1) grid of cells, each split on its
+// top-left --> bottom-right diagonal into two triangles, row by row.
+class QuadTessellation {
+public:
+    // Evaluates the grid for these corners (top-left, top-right, bottom-right, bottom-left).
+    // colors and texs may be null. Returns false, with nothing to draw, if level < 0.
+    bool evaluate(const GPoint verts[4], const GColor colors[4], const GPoint texs[4], int level);
+
+    // Evaluates a Coons patch bounded by four quadratic beziers (see
+    // GFinal::drawQuadraticCoons for the layout of pts) over the same grid. texs, the four
+    // corners' texture coordinates, may be null. Returns false if level < 0.
+    bool evaluateCoons(const GPoint pts[8], const GPoint texs[4], int level);
+
+    // Results of the last evaluate call; valid until the next one
+    const GPoint* verts() const { return fVerts.data(); }
+    const GColor* colors() const { return fColors.data(); }
+    const GPoint* texs() const { return fTexs.data(); }
+    const int* indices() const { return fGrid->indices.data(); }
+    int triangleCount() const { return static_cast<int>(fGrid->indices.size() / 3); }
+
+private:
+    struct Grid {
+        std::vector<float> steps;    // Parameter of each grid line, 0 ... 1
+        std::vector<int>   indices;  // Three per triangle
+    };
+
+    const Grid& grid(int level);
+    void evaluateTexs(const GPoint texs[4]);
+
+    std::map<int, Grid> fGrids;
+    const Grid*         fGrid = nullptr;
+
+    std::vector<GPoint> fVerts;
+    std::vector<GColor> fColors;
+    std::vector<GPoint> fTexs;
+
+    // The top and bottom edges at each grid column, shared by every row (and the left and
+    // right edges at each grid row, for Coons patches)
+    std::vector<GPoint> fTopVerts, fBottomVerts, fTopTexs, fBottomTexs;
+    std::vector<GPoint> fLeftVerts, fRightVerts;
+    // Each Coons column's running (TB - Corners) term and its step per row
+    std::vector<GPoint> fColumns, fColumnSteps;
+    std::vector<GColor> fTopColors, fBottomColors;
+};
+
+#endif
@@ -0,0 +1,287 @@
+#include "Stroker.h"
+#include "include/GMath.h"
+#include "include/GStrokeCanvas.h"
+#include "my_utils.h"
+#include <algorithm>
+#include <cmath>
+
+// Curves are chopped at most this many times deep, i.e. into at most 2^kMaxDepth pieces
+static constexpr int kMaxDepth = 6;
+
+// Each offset curve piece turns by at most about 45 degrees
+static constexpr float kMinPieceCos = 0.7f;
+
+static float cross(GVector a, GVector b) { return a.x * b.y - a.y * b.x; }
+static float dot(GVector a, GVector b) { return a.x * b.x + a.y * b.y; }
+
+static GVector normalize(GVector v) {
+    float length = v.length();
+    return length > 0 ? (1 / length) * v : GVector{0, 0};
+}
+
+// The left normal of a unit direction
+static GVector perp(GVector d) { return {-d.y, d.x}; }
+
+// Unit directions at the ends of a bezier, skipping control points that sit on the end point
+static GVector startTangent(const GPoint pts[], int count) {
+    for (int i = 1; i < count; ++i) {
+        if (pts[i] != pts[0]) {
+            return normalize(pts[i] - pts[0]);
+        }
+    }
+    return {0, 0};
+}
+
+static GVector endTangent(const GPoint pts[], int count) {
+    for (int i = count - 2; i >= 0; --i) {
+        if (pts[i] != pts[count - 1]) {
+            return normalize(pts[count - 1] - pts[i]);
+        }
+    }
+    return {0, 0};
+}
+
+Stroker::Stroker(float width, GStrokeJoin join, GStrokeCap cap, float miterLimit)
+    : fRadius(width / 2), fJoin(join), fCap(cap), fMiterLimit(miterLimit) {
+    // A quarter unit, like drawPath's flattening, or finer for thin strokes, which are usually
+    // thin because they will be scaled up
+    fTolerance = std::min(0.25f, fRadius * 0.05f);
+}
+
+void Stroker::strokePolyline(const GPoint pts[], int count, bool isClosed) {
+    if (count < 1) {
+        return;
+    }
+    this->beginContour(pts[0]);
+    for (int i = 1; i < count; ++i) {
+        this->addSegment(kLine, &pts[i - 1]);
+    }
+    if (isClosed && count > 1) {
+        GPoint closing[2] = {pts[count - 1], pts[0]};
+        this->addSegment(kLine, closing);
+    }
+    this->strokeContour(isClosed);
+}
+
+void Stroker::strokePath(const GPath& path) {
+    GPoint pts[GPath::kMaxNextPoints];
+    GPath::Iter iter(path);
+    bool inContour = false;
+    while (auto verb = iter.next(pts)) {
+        if (verb.value() == kMove) {
+            if (inContour) {
+                this->strokeContour(fSegments.size() > 0 &&
+                                    fSegments.back().end() == fContourStart);
+            }
+            this->beginContour(pts[0]);
+            inContour = true;
+        } else {
+            this->addSegment(verb.value(), pts);
+        }
+    }
+    if (inContour) {
+        this->strokeContour(fSegments.size() > 0 && fSegments.back().end() == fContourStart);
+    }
+}
+
+void Stroker::beginContour(GPoint start) {
+    fSegments.clear();
+    fContourStart = start;
+    fContourHasVerbs = false;
+}
+
+void Stroker::addSegment(GPathVerb verb, const GPoint pts[]) {
+    fContourHasVerbs = true;
+    Segment segment;
+    segment.verb = verb;
+    bool hasLength = false;
+    for (int i = 0; i <= verb; ++i) {
+        segment.pts[i] = pts[i];
+        hasLength |= pts[i] != pts[0];
+    }
+    if (hasLength) {
+        fSegments.push_back(segment);
+    }
+}
+
+void Stroker::strokeContour(bool isClosed) {
+    if (!(fRadius > 0)) {
+        return;
+    }
+    if (fSegments.empty()) {
+        if (fContourHasVerbs) {
+            this->addDot(fContourStart);
+        }
+        return;
+    }
+
+    for (int side = 0; side < 2; ++side) {
+        const Segment& first = fSegments.front();
+        const Segment& last = fSegments.back();
+        if (side == 0 || isClosed) {
+            fBuilder.moveTo(first.start() + fRadius * perp(startTangent(first.pts, first.count())));
+        }
+        this->offsetSide(isClosed);
+        if (!isClosed) {
+            this->cap(last.end(), perp(endTangent(last.pts, last.count())));
+        }
+
+        // Back along the other side: the left side of the reversed contour
+        std::reverse(fSegments.begin(), fSegments.end());
+        for (Segment& segment : fSegments) {
+            std::reverse(segment.pts, segment.pts + segment.count());
+        }
+    }
+}
+
+void Stroker::offsetSide(bool isClosed) {
+    int count = static_cast<int>(fSegments.size());
+    for (int i = 0; i < count; ++i) {
+        const Segment& segment = fSegments[i];
+        GVector endNormal = perp(endTangent(segment.pts, segment.count()));
+        if (segment.verb == kLine) {
+            fBuilder.lineTo(segment.end() + fRadius * endNormal);
+        } else {
+            this->offsetCurve(segment.pts, segment.count(), 0);
+        }
+        if (isClosed || i + 1 < count) {
+            const Segment& next = fSegments[(i + 1) % count];
+            this->join(segment.end(), endNormal, perp(startTangent(next.pts, next.count())));
+        }
+    }
+}
+
+// Offsets a quad (count 3) or cubic (count 4) by one quad whose control point is where the
+// offset tangents at its ends meet, chopping in half until that quad is close enough to the true
+// offset at the curve's midpoint.
+void Stroker::offsetCurve(const GPoint pts[], int count, int depth) {
+    GVector t0 = startTangent(pts, count), t1 = endTangent(pts, count);
+    GPoint end = pts[count - 1] + fRadius * perp(t1);
+
+    // The two halves; the midpoint and its tangent fall out of the chop
+    GPoint halves[7];
+    if (count == 3) {
+        GPath::ChopQuadAt(pts, halves, 0.5f);
+    } else {
+        GPath::ChopCubicAt(pts, halves, 0.5f);
+    }
+    GVector midTangent = normalize(halves[count] - halves[count - 2]);
+
+    bool fits = dot(t0, t1) >= kMinPieceCos && dot(midTangent, midTangent) > 0;
+    GPoint control;
+    if (fits) {
+        GPoint start = pts[0] + fRadius * perp(t0);
+        float denom = cross(t0, t1);
+        if (std::abs(denom) > 1e-6f) {
+            control = start + (cross(end - start, t1) / denom) * t0;
+        } else {
+            control = lerp(start, end, 0.5f);
+        }
+        GPoint target = halves[count - 1] + fRadius * perp(midTangent);
+        GPoint approx = 0.25f * (start + end) + 0.5f * control;
+        fits = (target - approx).length() <= fTolerance;
+    }
+
+    if (!fits && depth < kMaxDepth) {
+        this->offsetCurve(halves, count, depth + 1);
+        this->offsetCurve(halves + count - 1, count, depth + 1);
+    } else if (fits) {
+        fBuilder.quadTo(control, end);
+    } else {
+        fBuilder.lineTo(end);
+    }
+}
+
+void Stroker::join(GPoint pivot, GVector from, GVector to) {
+    GPoint end = pivot + fRadius * to;
+    float c = dot(from, to);
+
+    if (cross(from, to) > 0) {
+        // Inner side of the turn: the two offsets overlap, so cut back through the corner
+        fBuilder.lineTo(pivot);
+        fBuilder.lineTo(end);
+        return;
+    }
+    if (c >= 1 - 1e-6f) {
+        fBuilder.lineTo(end);  // Straight on
+        return;
+    }
+
+    switch (fJoin) {
+        case GStrokeJoin::kRound:
+            this->arc(pivot, from, to, std::acos(std::max(c, -1.0f)));
+            return;
+        case GStrokeJoin::kMiter:
+            // The miter point is (from + to) / (1 + c) radii out; its length is sqrt(2 / (1 + c))
+            if (1 + c > 0 && 2 <= fMiterLimit * fMiterLimit * (1 + c)) {
+                fBuilder.lineTo(pivot + (fRadius / (1 + c)) * (from + to));
+            }
+            break;
+        case GStrokeJoin::kBevel:
+            break;
+    }
+    fBuilder.lineTo(end);
+}
+void Stroker::cap(GPoint pivot, GVector normal) {
+    GVector back = {-normal.x, -normal.y};
+    switch (fCap) {
+        case GStrokeCap::kRound:
+            this->arc(pivot, normal, back, gFloatPI);
+            return;
+        case GStrokeCap::kSquare: {
+            GVector ahead = {normal.y, -normal.x};  // The direction of travel
+            fBuilder.lineTo(pivot + fRadius * (normal + ahead));
+            fBuilder.lineTo(pivot + fRadius * (back + ahead));
+            break;
+        }
+        case GStrokeCap::kButt:
+            break;
+    }
+    fBuilder.lineTo(pivot + fRadius * back);
+}
+
+// One quad per 45 degrees or less, like addCircle. Each quad's control point is where the
+// tangents at its ends meet, (u + v) / (1 + cos(step)) radii out.
+void Stroker::arc(GPoint center, GVector from, GVector to, float radians) {
+    int pieces = std::max(1, static_cast<int>(std::ceil(radians / (gFloatPI / 4) - 1e-4f)));
+    float step = radians / pieces;
+    float c = std::cos(step), s = std::sin(step);
+    float controlScale = fRadius / (1 + c);
+
+    GVector u = from;
+    for (int i = 0; i < pieces; ++i) {
+        GVector v = i + 1 < pieces ? GVector{u.x * c + u.y * s, u.y * c - u.x * s} : to;
+        fBuilder.quadTo(center + controlScale * (u + v), center + fRadius * v);
+        u = v;
+    }
+}
+
+void Stroker::addDot(GPoint center) {
+    switch (fCap) {
+        case GStrokeCap::kRound:
+            fBuilder.addCircle(center, fRadius);
+            break;
+        case GStrokeCap::kSquare:
+            fBuilder.addRect(GRect::LTRB(center.x - fRadius, center.y - fRadius,
+                                         center.x + fRadius, center.y + fRadius));
+            break;
+        case GStrokeCap::kButt:
+            break;
+    }
+}
+
+void Stroker::Draw(GCanvas* canvas, const GPath& path, float width, GStrokeJoin join,
+                   GStrokeCap cap, const GPaint& paint) {
+    if (auto strokeCanvas = dynamic_cast<GStrokeCanvas*>(canvas)) {
+        strokeCanvas->drawStroke(path, width, join, cap, paint);
+    } else {
+        DrawOutline(canvas, path, width, join, cap, paint);
+    }
+}
+
+void Stroker::DrawOutline(GCanvas* canvas, const GPath& path, float width, GStrokeJoin join,
+                          GStrokeCap cap, const GPaint& paint) {
+    Stroker stroker(width, join, cap);
+    stroker.strokePath(path);
+    canvas->drawPath(*stroker.detach(), paint);
+}
@@ -0,0 +1,82 @@
+#ifndef STROKER_H
+#define STROKER_H
+
+#include "include/GCanvas.h"
+#include "include/GFinal.h"
+#include "include/GPathBuilder.h"
+#include <memory>
+#include <vector>
+
+// Builds the outline of a stroke as a fill path (for the non-zero winding fill in drawPath).
+//
+// Each stroked contour becomes one outline: an open contour walks its left side forward, caps
+// the end, walks back along the right side and caps the start; a closed contour becomes an outer
+// and an inner loop. Joins only add geometry on the outer side of a turn (an arc of the turn's
+// angle, a miter point or nothing for a bevel). The inner side just runs through the corner,
+// which the winding fill covers, so the outline stays a few edges per input segment.
+//
+// Quads and cubics are offset directly: each is chopped until every piece turns less than 45
+// degrees and its offset is within tolerance of a single quad, which is then emitted.
+class Stroker {
+public:
+    // miterLimit bounds the miter length as a multiple of half the width, as in most 2D APIs
+    Stroker(float width, GStrokeJoin join, GStrokeCap cap, float miterLimit = 4);
+
+    // Appends the stroke of the polyline pts[0..count). Repeated points are ignored; a contour
+    // of zero length becomes a dot for round and square caps.
+    void strokePolyline(const GPoint pts[], int count, bool isClosed);
+
+    // Appends the stroke of every contour in path. A contour is stroked closed (joined instead
+    // of capped) if it ends where it started.
+    void strokePath(const GPath& path);
+
+    // Returns the outlines added so far and starts over
+    std::shared_ptr<GPath> detach() { return fBuilder.detach(); }
+
+    // Draws the stroke of path on canvas: a GStrokeCanvas draws it its own way, any other
+    // canvas fills the outline
+    static void Draw(GCanvas* canvas, const GPath& path, float width, GStrokeJoin join,
+                     GStrokeCap cap, const GPaint& paint);
+
+    // Fills the outline of the stroke of path on canvas
+    static void DrawOutline(GCanvas* canvas, const GPath& path, float width, GStrokeJoin join,
+                            GStrokeCap cap, const GPaint& paint);
+
+private:
+    struct Segment {
+        GPathVerb verb;   // kLine, kQuad or kCubic
+        GPoint pts[4];    // verb + 1 of them
+
+        int count() const { return verb + 1; }
+        GPoint start() const { return pts[0]; }
+        GPoint end() const { return pts[verb]; }
+    };
+
+    void beginContour(GPoint start);
+    void addSegment(GPathVerb verb, const GPoint pts[]);  // Skips segments of zero length
+    void strokeContour(bool isClosed);
+
+    // Walks the left side of fSegments (already at its start), joining between segments, and
+    // from the last back to the first if closed
+    void offsetSide(bool isClosed);
+    void offsetCurve(const GPoint pts[], int count, int depth);
+    void join(GPoint pivot, GVector from, GVector to);  // from, to are unit left normals
+    void cap(GPoint pivot, GVector normal);             // pivot + normal to pivot - normal
+    // Sweeps radians from center + from to center + to (unit vectors), turning the way a left
+    // normal turns toward the direction of travel
+    void arc(GPoint center, GVector from, GVector to, float radians);
+    void addDot(GPoint center);
+
+    float fRadius;
+    GStrokeJoin fJoin;
+    GStrokeCap fCap;
+    float fMiterLimit;
+    float fTolerance;  // How far an offset curve may stray from the true offset
+
+    GPathBuilder fBuilder;
+    GPoint fContourStart = {0, 0};
+    bool fContourHasVerbs = false;     // Any segments at all, even ones of zero length
+    std::vector<Segment> fSegments;    // The contour being stroked
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "SweepGradientShader.h"
+#include "my_utils.h"
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// atan(r) / 2pi for r in [0, 1] as an odd minimax polynomial; the error is about 1e-5 of a
+// turn, well under one table entry
+static constexpr float kAtanC1 = 0.15912117063999176f;
+static constexpr float kAtanC3 = -0.05185396969318390f;
+static constexpr float kAtanC5 = 0.02476101927459240f;
+static constexpr float kAtanC7 = -0.00705473823472857f;
+
+// Fraction of a turn, [0, 1), from the +x axis to (x, y). The polynomial covers the first
+// octant (|y| <= |x|); the others are reflections of it.
+static inline float turns(float x, float y) {
+    float ax = std::fabs(x);
+    float ay = std::fabs(y);
+    float r = std::min(ax, ay) / std::max(std::max(ax, ay), 1e-30f);
+    float r2 = r * r;
+    float t = r * (kAtanC1 + r2 * (kAtanC3 + r2 * (kAtanC5 + r2 * kAtanC7)));
+    if (ay > ax) {
+        t = 0.25f - t;
+    }
+    if (x < 0) {
+        t = 0.5f - t;
+    }
+    if (y < 0) {
+        t = 1 - t;
+    }
+    return t;
+}
+
+#if defined(__SSE2__)
+// The same, four at a time, with the reflections done as masked selects. The ratio uses the
+// approximate reciprocal: its 12 bits move the angle by less than 1e-4 of a turn.
+static inline __m128 turns(__m128 x, __m128 y) {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 ax = _mm_andnot_ps(signMask, x);
+    __m128 ay = _mm_andnot_ps(signMask, y);
+    __m128 r = _mm_mul_ps(_mm_min_ps(ax, ay), _mm_rcp_ps(_mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(1e-30f))));
+    __m128 r2 = _mm_mul_ps(r, r);
+    __m128 t = _mm_add_ps(_mm_set1_ps(kAtanC5), _mm_mul_ps(r2, _mm_set1_ps(kAtanC7)));
+    t = _mm_add_ps(_mm_set1_ps(kAtanC3), _mm_mul_ps(r2, t));
+    t = _mm_add_ps(_mm_set1_ps(kAtanC1), _mm_mul_ps(r2, t));
+    t = _mm_mul_ps(r, t);
+
+    auto select = [](__m128 mask, __m128 a, __m128 b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    };
+    t = select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(0.25f), t), t);
+    t = select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(0.5f), t), t);
+    t = select(_mm_cmplt_ps(y, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(1), t), t);
+    return t;
+}
+#endif
+
+SweepGradientShader::SweepGradientShader(GPoint center, float startRadians, const GColor colors[],
+                                         int count)
+    : fCenter(center), fColors(colors, colors + count),
+      fStartOffset(kLutSize * tileRepeat(-startRadians / (2 * gFloatPI), 1)) {}
+
+bool SweepGradientShader::isOpaque() {
+    for (const auto& color : fColors) {
+        if (color.a < 1.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<GShader> SweepGradientShader::copy() const {
+    return std::make_shared<SweepGradientShader>(*this);
+}
+
+bool SweepGradientShader::setContext(const GMatrix& ctm) {
+    auto inverse = GMatrix::Concat(ctm, GMatrix::Translate(fCenter.x, fCenter.y)).invert();
+    if (!inverse) {
+        return false;
+    }
+    fInverseMatrix = inverse.value();
+
+    // The colors never change, so the table is built by the first draw and reused after
+    if (fLut.empty()) {
+        this->buildLut();
+    }
+    return true;
+}
+
+// The sweep wraps, so entries cover [0, 1) of the turn and the last color is reached only as
+// the angle comes back around to the start
+void SweepGradientShader::buildLut() {
+    int count = static_cast<int>(fColors.size());
+    fLut.resize(kLutSize);
+    for (int i = 0; i < kLutSize; ++i) {
+        float t = static_cast<float>(i) / kLutSize;
+        int index = std::min(static_cast<int>(t * (count - 1)), count - 1);
+        float localT = (t * (count - 1)) - index;
+        GColor color = lerpColor(fColors[index], fColors[std::min(index + 1, count - 1)], localT);
+        fLut[i] = ColorToPixel(color);
+    }
+}
+
+void SweepGradientShader::shadeRow(int x, int y, int count, GPixel row[]) {
+    GPoint start = {x + 0.5f, y + 0.5f};
+    fInverseMatrix.mapPoints(&start, &start, 1);
+    float dx = fInverseMatrix[0];
+    float dy = fInverseMatrix[1];
+
+    // Rounding to the nearest entry, then wrapping: the start angle is only this offset
+    const float offset = fStartOffset + 0.5f;
+    const int mask = kLutSize - 1;
+
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 lane = _mm_setr_ps(0, 1, 2, 3);
+    for (; i + 4 <= count; i += 4) {
+        __m128 n = _mm_add_ps(_mm_set1_ps(static_cast<float>(i)), lane);
+        __m128 px = _mm_add_ps(_mm_set1_ps(start.x), _mm_mul_ps(n, _mm_set1_ps(dx)));
+        __m128 py = _mm_add_ps(_mm_set1_ps(start.y), _mm_mul_ps(n, _mm_set1_ps(dy)));
+        __m128 entry = _mm_add_ps(_mm_mul_ps(turns(px, py), _mm_set1_ps(kLutSize)), _mm_set1_ps(offset));
+
+        // Floor (truncation rounds negative offsets the wrong way), then wrap
+        __m128i index = _mm_cvttps_epi32(entry);
+        index = _mm_add_epi32(index, _mm_castps_si128(_mm_cmplt_ps(entry, _mm_cvtepi32_ps(index))));
+        alignas(16) int indices[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_and_si128(index, _mm_set1_epi32(mask)));
+        row[i + 0] = fLut[indices[0]];
+        row[i + 1] = fLut[indices[1]];
+        row[i + 2] = fLut[indices[2]];
+        row[i + 3] = fLut[indices[3]];
+    }
+#endif
+    for (; i < count; ++i) {
+        float entry = turns(start.x + i * dx, start.y + i * dy) * kLutSize + offset;
+        row[i] = fLut[static_cast<int>(std::floor(entry)) & mask];
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef SWEEP_GRADIENT_SHADER_H
+#define SWEEP_GRADIENT_SHADER_H
+
+#include "CopyableShader.h"
+#include "include/GMatrix.h"
+#include "include/GColor.h"
+#include <vector>
+
+// Colors are spread evenly around center, clockwise (in device space, y down) from
+// startRadians. Like the linear gradient, each pixel is a table lookup: the angle comes from a
+// polynomial atan and startRadians is just an offset into the table.
+class SweepGradientShader : public CopyableShader {
+public:
+    SweepGradientShader(GPoint center, float startRadians, const GColor colors[], int count);
+
+    bool isOpaque() override;
+    bool setContext(const GMatrix& ctm) override;
+    void shadeRow(int x, int y, int count, GPixel row[]) override;
+    std::shared_ptr<GShader> copy() const override;
+
+    // Entries per turn; a power of two, so indices wrap with a mask
+    static constexpr int kLutSize = 1024;
+
+private:
+    void buildLut();
+
+    GPoint fCenter;
+    std::vector<GColor> fColors;
+    float fStartOffset;          // -startRadians, in table entries, wrapped to [0, kLutSize]
+    std::vector<GPixel> fLut;    // Entry i holds the premultiplied color i / kLutSize of a turn past the start
+    GMatrix fInverseMatrix;      // Device to center-relative local space
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int threadCount) {
+    for (int i = 1; i < threadCount; ++i) {
+        fThreads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fQuit = true;
+    }
+    fWake.notify_all();
+    for (auto& thread : fThreads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::run(int count, const std::function<void(int, int)>& task) {
+    if (count <= 0) {
+        return;
+    }
+    if (count == 1 || fThreads.empty()) {
+        // Not worth waking anyone up
+        for (int i = 0; i < count; ++i) {
+            task(i, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fTask = &task;
+        fCount = count;
+        fNext = 0;
+        fPending = count;
+        ++fGeneration;
+    }
+    fWake.notify_all();
+
+    this->drain(0);
+
+    std::unique_lock<std::mutex> lock(fMutex);
+    fDone.wait(lock, [this] { return fPending == 0; });
+    fTask = nullptr;
+}
+
+// Claim and run tasks from the current batch until there are none left
+void ThreadPool::drain(int worker) {
+    std::unique_lock<std::mutex> lock(fMutex);
+    while (fTask && fNext < fCount) {
+        int index = fNext++;
+        const auto* task = fTask;
+        lock.unlock();
+        (*task)(index, worker);
+        lock.lock();
+        if (--fPending == 0) {
+            fDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::workerLoop(int worker) {
+    unsigned seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fWake.wait(lock, [&] { return fQuit || fGeneration != seen; });
+            if (fQuit) {
+                return;
+            }
+            seen = fGeneration;
+        }
+        this->drain(worker);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run batches of indexed tasks. The calling thread takes
+// part in every batch as worker 0, so a pool of N threads has N - 1 background threads.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    int threadCount() const { return static_cast<int>(fThreads.size()) + 1; }
+
+    // Run task(index, worker) for every index in [0, count) and return once all have finished.
+    // worker is in [0, threadCount()) and is unique among the tasks running at the same time.
+    void run(int count, const std::function<void(int index, int worker)>& task);
+
+private:
+    void workerLoop(int worker);
+    void drain(int worker);
+
+    std::vector<std::thread> fThreads;
+    std::mutex fMutex;
+    std::condition_variable fWake;
+    std::condition_variable fDone;
+
+    // The current batch; guarded by fMutex
+    const std::function<void(int, int)>* fTask = nullptr;
+    int fCount = 0;
+    int fNext = 0;
+    int fPending = 0;
+    unsigned fGeneration = 0;
+    bool fQuit = false;
+};
+
+#endif
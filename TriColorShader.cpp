@@ -1,51 +1,85 @@
 #include "TriColorShader.h"
 #include "my_utils.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 TriColorShader::TriColorShader(const GPoint pts[3], const GColor cols[3]) {
     memcpy(fPts, pts, sizeof(fPts));
     memcpy(fCols, cols, sizeof(fCols));
-
-    GMatrix basis(
-        fPts[1].x - fPts[0].x, fPts[2].x - fPts[0].x, fPts[0].x - 0,
-        fPts[1].y - fPts[0].y, fPts[2].y - fPts[0].y, fPts[0].y - 0
-    );
-
-    // Compute the inverse area of the triangle
-    float area = computeTriangleArea(fPts[0], fPts[1], fPts[2]);
-    fAreaInv = (area != 0) ? (1.0f / area) : 0.0f;
 }
 
 bool TriColorShader::isOpaque() {
     return fCols[0].a == 1 && fCols[1].a == 1 && fCols[2].a == 1;
 }
 
+// The inverse of CTM * basis takes a device point to barycentric (u, v), where the color is
+// c0 + u * (c1 - c0) + v * (c2 - c0). Folding that into the inverse gives the color's own
+// affine map, so shading a row is one add per component per pixel.
 bool TriColorShader::setContext(const GMatrix& ctm) {
     GMatrix basis = compute_basis(fPts[0], fPts[1], fPts[2]);
-    if (!GMatrix::Concat(ctm, basis).invert()) {
+    auto inverse = GMatrix::Concat(ctm, basis).invert();
+    if (!inverse) {
         return false;
     }
-    fInverseCTM = ctm.invert().value();
+    const GMatrix& m = inverse.value();
+
+    // Premultiply the corners, so the interpolated color is premul too
+    float c[3][4];
+    for (int i = 0; i < 3; ++i) {
+        GColor col = fCols[i].pinToUnit();
+        float a = col.a * 255;
+        c[i][0] = col.b * a;
+        c[i][1] = col.g * a;
+        c[i][2] = col.r * a;
+        c[i][3] = a;
+    }
+
+    for (int k = 0; k < 4; ++k) {
+        float du = c[1][k] - c[0][k];
+        float dv = c[2][k] - c[0][k];
+        fDx[k] = du * m[0] + dv * m[1];
+        fDy[k] = du * m[2] + dv * m[3];
+        fOrigin[k] = c[0][k] + du * m[4] + dv * m[5];
+    }
     return true;
 }
 
 void TriColorShader::shadeRow(int x, int y, int count, GPixel row[]) {
-    for (int i = 0; i < count; ++i) {
-        GPoint p = {x + 0.5f + i, y + 0.5f};
-        p = fInverseCTM *p;
+    float cx = x + 0.5f;
+    float cy = y + 0.5f;
 
-        float w0 = fAreaInv * computeTriangleArea(fPts[1], fPts[2], p);
-        float w1 = fAreaInv * computeTriangleArea(fPts[2], fPts[0], p);
-        float w2 = fAreaInv * computeTriangleArea(fPts[0], fPts[1], p);
-
-        GColor color = GColor::RGBA(
-            fCols[0].r * w0 + fCols[1].r * w1 + fCols[2].r * w2,
-            fCols[0].g * w0 + fCols[1].g * w1 + fCols[2].g * w2,
-            fCols[0].b * w0 + fCols[1].b * w1 + fCols[2].b * w2,
-            fCols[0].a * w0 + fCols[1].a * w1 + fCols[2].a * w2
-        ).pinToUnit();
-
-        row[i] = ColorToPixel(color);
+#if defined(__SSE2__)
+    __m128 color = _mm_add_ps(_mm_loadu_ps(fOrigin),
+                              _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(fDx), _mm_set1_ps(cx)),
+                                         _mm_mul_ps(_mm_loadu_ps(fDy), _mm_set1_ps(cy))));
+    __m128 dx = _mm_loadu_ps(fDx);
+    const __m128 zero = _mm_setzero_ps();
+    for (int i = 0; i < count; ++i) {
+        // Pixel centers near the edges can extrapolate a little past the corner colors; pin to
+        // [0, alpha] so the result is a valid premul pixel
+        __m128 alpha = _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3));
+        __m128 pinned = _mm_min_ps(_mm_max_ps(color, zero), _mm_min_ps(alpha, _mm_set1_ps(255)));
+        __m128i c = _mm_cvtps_epi32(pinned);
+        c = _mm_packs_epi32(c, c);
+        row[i] = _mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+        color = _mm_add_ps(color, dx);
+    }
+#else
+    float color[4];
+    for (int k = 0; k < 4; ++k) {
+        color[k] = fOrigin[k] + fDx[k] * cx + fDy[k] * cy;
     }
+    for (int i = 0; i < count; ++i) {
+        int a = GRoundToInt(std::max(0.0f, std::min(color[3], 255.0f)));
+        int r = std::min(GRoundToInt(std::max(0.0f, color[2])), a);
+        int g = std::min(GRoundToInt(std::max(0.0f, color[1])), a);
+        int b = std::min(GRoundToInt(std::max(0.0f, color[0])), a);
+        row[i] = GPixel_PackARGB(a, r, g, b);
+        for (int k = 0; k < 4; ++k) {
+            color[k] += fDx[k];
+        }
+    }
+#endif
 }
-
-
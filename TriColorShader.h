@@ -8,8 +8,12 @@
 class TriColorShader : public GShader {
     GPoint fPts[3];  // Triangle vertices
     GColor fCols[3]; // Vertex colors
-    float fAreaInv; // Inverse matrix for barycentric calculation
-    GMatrix fInverseCTM;
+
+    // Premultiplied color, scaled to 0...255, as an affine function of device (x, y):
+    // color = fOrigin + x * fDx + y * fDy. Components are in B, G, R, A order to match GPixel.
+    float fOrigin[4];
+    float fDx[4];
+    float fDy[4];
 
 public:
     TriColorShader(const GPoint pts[3], const GColor cols[3]);
@@ -0,0 +1,145 @@
+#include "VoronoiShader.h"
+#include "my_utils.h"
+#include <cmath>
+#include <limits>
+
+VoronoiShader::VoronoiShader(const GPoint points[], const GColor colors[], int count)
+    : fPoints(points, points + count) {
+    fPixels.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        fPixels.push_back(ColorToPixel(colors[i].pinToUnit()));
+        fOpaque = fOpaque && colors[i].a >= 1;
+    }
+
+    // Size the grid for about one site per cell
+    GRect bounds = computeBounds(points, count);
+    fOrigin = {bounds.left, bounds.top};
+    fCols = fRows = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<float>(count)))));
+    fCellSize[0] = std::max(bounds.width() / fCols, 1e-6f);
+    fCellSize[1] = std::max(bounds.height() / fRows, 1e-6f);
+    fInvCellSize[0] = 1 / fCellSize[0];
+    fInvCellSize[1] = 1 / fCellSize[1];
+
+    // Bucket the sites: count per cell, prefix sum, then place
+    auto cellOf = [&](GPoint p) {
+        int cx = std::min(std::max(static_cast<int>((p.x - fOrigin.x) * fInvCellSize[0]), 0), fCols - 1);
+        int cy = std::min(std::max(static_cast<int>((p.y - fOrigin.y) * fInvCellSize[1]), 0), fRows - 1);
+        return cy * fCols + cx;
+    };
+    fCellStart.assign(fCols * fRows + 1, 0);
+    for (const GPoint& p : fPoints) {
+        fCellStart[cellOf(p) + 1] += 1;
+    }
+    for (int i = 0; i < fCols * fRows; ++i) {
+        fCellStart[i + 1] += fCellStart[i];
+    }
+    fCellSites.resize(count);
+    std::vector<int> next(fCellStart.begin(), fCellStart.end() - 1);
+    for (int i = 0; i < count; ++i) {
+        fCellSites[next[cellOf(fPoints[i])]++] = i;
+    }
+}
+
+bool VoronoiShader::isOpaque() {
+    return fOpaque;
+}
+
+std::shared_ptr<GShader> VoronoiShader::copy() const {
+    return std::make_shared<VoronoiShader>(*this);
+}
+
+bool VoronoiShader::setContext(const GMatrix& ctm) {
+    auto inverse = ctm.invert();
+    if (!inverse) {
+        return false;
+    }
+    fInverseCTM = inverse.value();
+    return true;
+}
+
+// Searches square rings of cells outward from p's cell. Any site outside the rings visited
+// so far is at least as far as the nearest side of their box that still has cells beyond it
+// (measured within the grid, which matters when p is outside it), so the search stops once
+// that distance can't beat the best site found.
+//
+// Ties go to the lower index, so the answer doesn't depend on the hint or the visiting order
+// (and band-parallel rendering matches serial).
+int VoronoiShader::nearest(GPoint p, int hint) const {
+    auto distance2 = [&](int i) {
+        float dx = fPoints[i].x - p.x;
+        float dy = fPoints[i].y - p.y;
+        return dx * dx + dy * dy;
+    };
+
+    int best = hint;
+    float bestDistance2 = distance2(hint);
+
+    float gx = (p.x - fOrigin.x) * fInvCellSize[0];
+    float gy = (p.y - fOrigin.y) * fInvCellSize[1];
+    // Clamped into the grid; written so that NaN lands on 0
+    int cx = gx > 0 ? static_cast<int>(std::min(gx, fCols - 1.0f)) : 0;
+    int cy = gy > 0 ? static_cast<int>(std::min(gy, fRows - 1.0f)) : 0;
+
+    // How far p is outside the grid on each axis; every unvisited cell is at least that far
+    auto square = [](float v) { return v * v; };
+    auto outside = [](float v, float lo, float hi) { return std::max({lo - v, v - hi, 0.0f}); };
+    float outsideX2 = square(outside(p.x, fOrigin.x, fOrigin.x + fCols * fCellSize[0]));
+    float outsideY2 = square(outside(p.y, fOrigin.y, fOrigin.y + fRows * fCellSize[1]));
+
+    const float kNone = std::numeric_limits<float>::infinity();
+    for (int r = 0; ; ++r) {
+        int left = cx - r, right = cx + r, top = cy - r, bottom = cy + r;
+
+        // Visit the cells on this ring that exist
+        for (int y = std::max(top, 0); y <= std::min(bottom, fRows - 1); ++y) {
+            bool edgeRow = y == top || y == bottom;
+            int step = edgeRow ? 1 : right - left;
+            for (int x = left; x <= right; x += std::max(step, 1)) {
+                if (x < 0 || x >= fCols) {
+                    continue;
+                }
+                int cell = y * fCols + x;
+                for (int k = fCellStart[cell]; k < fCellStart[cell + 1]; ++k) {
+                    int i = fCellSites[k];
+                    float d = distance2(i);
+                    if (d < bestDistance2 || (d == bestDistance2 && i < best)) {
+                        best = i;
+                        bestDistance2 = d;
+                    }
+                }
+            }
+        }
+
+        // Squared distance from p to the nearest unvisited cell
+        float gap2 = kNone;
+        if (left > 0) {
+            gap2 = std::min(gap2, square(p.x - (fOrigin.x + left * fCellSize[0])) + outsideY2);
+        }
+        if (right < fCols - 1) {
+            gap2 = std::min(gap2, square(fOrigin.x + (right + 1) * fCellSize[0] - p.x) + outsideY2);
+        }
+        if (top > 0) {
+            gap2 = std::min(gap2, square(p.y - (fOrigin.y + top * fCellSize[1])) + outsideX2);
+        }
+        if (bottom < fRows - 1) {
+            gap2 = std::min(gap2, square(fOrigin.y + (bottom + 1) * fCellSize[1] - p.y) + outsideX2);
+        }
+        // Done once nothing unvisited can be nearer, or once every cell has been visited (the
+        // distances may have overflowed to inf or NaN, which no gap would ever exceed)
+        if (gap2 > bestDistance2 || gap2 == kNone || r > std::max(fCols, fRows)) {
+            return best;
+        }
+    }
+}
+
+void VoronoiShader::shadeRow(int x, int y, int count, GPixel row[]) {
+    GPoint start = {x + 0.5f, y + 0.5f};
+    fInverseCTM.mapPoints(&start, &start, 1);
+    GPoint step = {fInverseCTM[0], fInverseCTM[1]};
+
+    int site = 0;
+    for (int i = 0; i < count; ++i) {
+        site = this->nearest(start + step * static_cast<float>(i), site);
+        row[i] = fPixels[site];
+    }
+}
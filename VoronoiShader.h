@@ -0,0 +1,43 @@
+#ifndef VORONOI_SHADER_H
+#define VORONOI_SHADER_H
+
+#include "CopyableShader.h"
+#include "include/GMatrix.h"
+#include "include/GColor.h"
+#include <vector>
+
+// Colors each pixel with the color of the nearest site (in the shader's local space). The
+// sites are bucketed into a uniform grid of about one site per cell, and each pixel starts
+// from the previous pixel's site, so the search visits only the few cells around it no matter
+// how many sites there are.
+class VoronoiShader : public CopyableShader {
+public:
+    // The points and colors are copied
+    VoronoiShader(const GPoint points[], const GColor colors[], int count);
+
+    bool isOpaque() override;
+    bool setContext(const GMatrix& ctm) override;
+    void shadeRow(int x, int y, int count, GPixel row[]) override;
+    std::shared_ptr<GShader> copy() const override;
+
+private:
+    // Index of the site nearest p; hint is any site, used as the first candidate
+    int nearest(GPoint p, int hint) const;
+
+    std::vector<GPoint> fPoints;
+    std::vector<GPixel> fPixels;  // Premultiplied site colors
+    bool fOpaque = true;
+
+    // Grid over the sites' bounds: cell (cx, cy) holds
+    // fCellSites[fCellStart[i] ... fCellStart[i + 1]) with i = cy * fCols + cx
+    GPoint fOrigin;
+    float fInvCellSize[2];
+    float fCellSize[2];
+    int fCols, fRows;
+    std::vector<int> fCellStart;
+    std::vector<int> fCellSites;
+
+    GMatrix fInverseCTM;
+};
+
+#endif
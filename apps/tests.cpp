@@ -0,0 +1,901 @@
+/**
+ *  Regression tests for cases the image scenes don't reach. Each test returns true on success.
+ */
+
+#include "../include/GBitmap.h"
+#include "../include/GCanvas.h"
+#include "../include/GFinal.h"
+#include "../include/GPaint.h"
+#include "../include/GPathBuilder.h"
+#include "../include/GPicture.h"
+#include "../include/GRect.h"
+#include "../include/GShader.h"
+#include "../CopyableShader.h"
+#include "../my_blend.h"
+#include "../QuadTessellation.h"
+#include "../Stroker.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static GBitmap alloc_bitmap(int width, int height) {
+    GBitmap bm;
+    bm.alloc(width, height);
+    return bm;
+}
+
+static const GPoint kSites[] = {{10, 10}, {90, 20}, {50, 50}, {20, 80}, {80, 90}};
+static const GColor kSiteColors[] = {
+    {1, 0, 0, 1}, {0, 1, 0, 1}, {0, 0, 1, 1}, {1, 1, 0, 1}, {0, 1, 1, 1},
+};
+
+// Pixels far outside the sites' grid still find the nearest site
+static bool test_voronoi_far_away() {
+    auto shader = GCreateFinal()->createVoronoiShader(kSites, kSiteColors, 5);
+    GBitmap bm = alloc_bitmap(16, 16);
+    auto canvas = GCreateCanvas(bm);
+    canvas->translate(-1e6f, 3e5f);
+    canvas->drawRect(GRect::LTRB(1e6f, -3e5f, 1e6f + 16, -3e5f + 16), GPaint(shader));
+
+    // Local (1e6, -3e5) is nearest the site at (90, 20)
+    bool ok = *bm.getAddr(8, 8) == *bm.getAddr(0, 0) && GPixel_GetG(*bm.getAddr(8, 8)) == 255 &&
+              GPixel_GetR(*bm.getAddr(8, 8)) == 0 && GPixel_GetB(*bm.getAddr(8, 8)) == 0;
+    free(bm.pixels());
+    return ok;
+}
+
+// Coordinates so large that squared distances overflow must not hang the search
+static bool test_voronoi_huge_coordinates() {
+    auto shader = GCreateFinal()->createVoronoiShader(kSites, kSiteColors, 5);
+    GBitmap bm = alloc_bitmap(64, 64);
+    auto canvas = GCreateCanvas(bm);
+    canvas->scale(1e-18f, 1e-18f);
+    canvas->drawRect(GRect::LTRB(-3e19f, -3e19f, 3e19f, 3e19f), GPaint(shader));
+    bool ok = GPixel_GetA(*bm.getAddr(10, 10)) == 255;  // Some site's (opaque) color
+    free(bm.pixels());
+    return ok;
+}
+
+// Chained color matrices must act as if the inner result were premultiplied in between: an
+// inner matrix that zeroes alpha loses the color, even if the outer one restores alpha
+static bool test_colormatrix_alpha_zeroing_chain() {
+    auto final = GCreateFinal();
+    auto red = GCreateLinearGradient({0, 0}, {16, 0}, {1, 0, 0, 1}, {1, 0, 0, 1});
+    GColorMatrix zeroAlpha({1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 0,  0, 0, 0, 0});
+    GColorMatrix opaque({1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 0,  0, 0, 0, 1});
+    auto inner = final->createColorMatrixShader(zeroAlpha, red.get());
+    auto outer = final->createColorMatrixShader(opaque, inner.get());
+
+    GBitmap bm = alloc_bitmap(16, 16);
+    auto canvas = GCreateCanvas(bm);
+    canvas->drawRect(GRect::LTRB(0, 0, 16, 16), GPaint(outer));
+    bool ok = *bm.getAddr(8, 8) == GPixel_PackARGB(255, 0, 0, 0);  // Opaque black
+    free(bm.pixels());
+    return ok;
+}
+
+// Fusing a matrix onto a copied color-matrix shader must keep the copy's real shader alive
+// after the copy itself is released
+static bool test_colormatrix_fused_copy_keeps_real_shader() {
+    auto final = GCreateFinal();
+    auto red = GCreateLinearGradient({0, 0}, {16, 0}, {1, 0, 0, 1}, {1, 0, 0, 1});
+    GColorMatrix swapRG({0, 1, 0, 0,  1, 0, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1,  0, 0, 0, 0});
+    auto inner = final->createColorMatrixShader(swapRG, red.get());
+    auto copy = static_cast<CopyableShader*>(inner.get())->copy();
+    auto outer = final->createColorMatrixShader(swapRG, copy.get());
+    copy.reset();
+    inner.reset();
+
+    GBitmap bm = alloc_bitmap(16, 16);
+    auto canvas = GCreateCanvas(bm);
+    canvas->drawRect(GRect::LTRB(0, 0, 16, 16), GPaint(outer));
+    bool ok = *bm.getAddr(8, 8) == GPixel_PackARGB(255, 255, 0, 0);  // Swapped back to red
+    free(bm.pixels());
+    return ok;
+}
+
+// The vector row kernels (AVX2 and SSE2 where built in) match the scalar blend for every mode.
+// 19 pixels run through an 8-wide, a 4-wide and a scalar tail.
+static bool test_blend_row_matches_scalar() {
+    struct ModeRec {
+        GBlendMode mode;
+        BlendFunc* scalar;
+    };
+    const ModeRec modes[] = {
+        { GBlendMode::kClear, blend_clear }, { GBlendMode::kSrc, blend_src },
+        { GBlendMode::kDst, blend_dst }, { GBlendMode::kSrcOver, blend_srcOver },
+        { GBlendMode::kDstOver, blend_dstOver }, { GBlendMode::kSrcIn, blend_srcIn },
+        { GBlendMode::kDstIn, blend_dstIn }, { GBlendMode::kSrcOut, blend_srcOut },
+        { GBlendMode::kDstOut, blend_dstOut }, { GBlendMode::kSrcATop, blend_srcATop },
+        { GBlendMode::kDstATop, blend_dstATop }, { GBlendMode::kXor, blend_xor },
+    };
+
+    // Premultiplied pixels, including fully transparent and fully opaque ones
+    const int n = 19;
+    GPixel src[n], dst[n];
+    unsigned seed = 1;
+    auto next = [&seed]() { return (seed = seed * 1103515245 + 12345) >> 16; };
+    for (int i = 0; i < n; ++i) {
+        unsigned sa = i == 0 ? 0 : i == 1 ? 255 : next() & 255;
+        unsigned da = i == 2 ? 0 : i == 3 ? 255 : next() & 255;
+        src[i] = GPixel_PackARGB(sa, next() % (sa + 1), next() % (sa + 1), next() % (sa + 1));
+        dst[i] = GPixel_PackARGB(da, next() % (da + 1), next() % (da + 1), next() % (da + 1));
+    }
+
+    for (const ModeRec& rec : modes) {
+        GPixel row[n];
+        memcpy(row, dst, sizeof(row));
+        blendRow(rec.mode, src, row, n);
+        for (int i = 0; i < n; ++i) {
+            if (row[i] != rec.scalar(src[i], dst[i])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// An antialiased edge halfway across a pixel column or row gives it half coverage, and the
+// pixels on either side none and full
+static bool test_aa_half_pixel_edge_coverage() {
+    GBitmap bitmap = alloc_bitmap(16, 16);
+    memset(bitmap.pixels(), 0, 16 * bitmap.rowBytes());
+    const GPoint pts[] = {{2.5f, 3.5f}, {12, 3.5f}, {12, 12}, {2.5f, 12}};
+    GPaint paint({1, 1, 1, 1});
+    paint.setAntiAlias(true);
+    GCreateCanvas(bitmap)->drawConvexPolygon(pts, 4, paint);
+
+    auto alpha = [&](int x, int y) { return static_cast<int>(GPixel_GetA(*bitmap.getAddr(x, y))); };
+    bool ok = alpha(1, 8) == 0 && abs(alpha(2, 8) - 128) <= 1 && alpha(3, 8) == 255 &&
+              alpha(8, 2) == 0 && abs(alpha(8, 3) - 128) <= 1 && alpha(8, 4) == 255 &&
+              abs(alpha(2, 3) - 64) <= 1;  // Half of each: a quarter covered
+    free(bitmap.pixels());
+    return ok;
+}
+
+// Away from its edges an antialiased path draws exactly what an aliased one does, shader,
+// blending and all
+static bool test_aa_interior_matches_aliased() {
+    const int size = 64;
+    GBitmap aliased = alloc_bitmap(size, size);
+    GBitmap smooth = alloc_bitmap(size, size);
+    for (GBitmap* bitmap : {&aliased, &smooth}) {
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                *bitmap->getAddr(x, y) = GPixel_PackARGB(200, 10 + x, 100, 150 - y);
+            }
+        }
+    }
+
+    auto path = GPathBuilder::Build([](GPathBuilder& bu) {
+        bu.addCircle({32, 32}, 25.3f);
+    });
+    GPaint paint(GCreateLinearGradient({0, 0}, {64, 64}, {1, 0, 0, 0.7f}, {0, 0, 1, 0.4f}));
+    GCreateCanvas(aliased)->drawPath(*path, paint);
+    paint.setAntiAlias(true);
+    GCreateCanvas(smooth)->drawPath(*path, paint);
+
+    bool ok = true;
+    for (int y = 20; y < 44; ++y) {
+        for (int x = 20; x < 44; ++x) {
+            ok = ok && *aliased.getAddr(x, y) == *smooth.getAddr(x, y);
+        }
+    }
+    ok = ok && *aliased.getAddr(32, 32) != GPixel_PackARGB(200, 42, 100, 118);  // It drew
+    free(aliased.pixels());
+    free(smooth.pixels());
+    return ok;
+}
+
+static const GPixel kRed = GPixel_PackARGB(255, 255, 0, 0);
+static const GPixel kBlue = GPixel_PackARGB(255, 0, 0, 255);
+
+// Restore brings back the clip from before each save: a nested path clip, then a rect clip
+static bool test_clip_save_restore() {
+    GBitmap bitmap = alloc_bitmap(64, 64);
+    memset(bitmap.pixels(), 0, 64 * bitmap.rowBytes());
+    auto canvas = GCreateCanvas(bitmap);
+    const GRect everything = GRect::LTRB(0, 0, 64, 64);
+
+    canvas->save();
+    canvas->clipRect(GRect::LTRB(10, 10, 40, 40));
+    canvas->save();
+    canvas->clipPath(*GPathBuilder::Build([](GPathBuilder& bu) {
+        bu.addCircle({25, 25}, 5);
+    }));
+    canvas->restore();
+    canvas->drawRect(everything, GPaint({0, 0, 1, 1}));
+    canvas->restore();
+    bool ok = *bitmap.getAddr(12, 12) == kBlue && *bitmap.getAddr(39, 39) == kBlue &&
+              *bitmap.getAddr(9, 20) == 0 && *bitmap.getAddr(40, 20) == 0;
+
+    canvas->drawRect(everything, GPaint({1, 0, 0, 1}));
+    ok = ok && *bitmap.getAddr(0, 0) == kRed && *bitmap.getAddr(63, 63) == kRed;
+    free(bitmap.pixels());
+    return ok;
+}
+
+// A clip rect under a rotated CTM clips to the rotated shape (a diamond here), not just its
+// device bounds
+static bool test_clip_rotated_rect() {
+    GBitmap bitmap = alloc_bitmap(64, 64);
+    memset(bitmap.pixels(), 0, 64 * bitmap.rowBytes());
+    auto canvas = GCreateCanvas(bitmap);
+    canvas->translate(32, 32);
+    canvas->rotate(0.785398163f);
+    canvas->clipRect(GRect::LTRB(-16, -16, 16, 16));  // Reaches 22.6 from the center
+    canvas->drawRect(GRect::LTRB(-40, -40, 40, 40), GPaint({1, 0, 0, 1}));
+
+    bool ok = *bitmap.getAddr(32, 32) == kRed && *bitmap.getAddr(52, 32) == kRed &&
+              *bitmap.getAddr(32, 12) == kRed &&
+              *bitmap.getAddr(47, 47) == 0 && *bitmap.getAddr(16, 16) == 0 &&  // Inside the bounds
+              *bitmap.getAddr(56, 32) == 0;
+    free(bitmap.pixels());
+    return ok;
+}
+
+// Nested path clips intersect: two overlapping circles leave only their lens
+static bool test_clip_nested_paths_intersect() {
+    GBitmap bitmap = alloc_bitmap(64, 64);
+    memset(bitmap.pixels(), 0, 64 * bitmap.rowBytes());
+    auto canvas = GCreateCanvas(bitmap);
+    canvas->clipPath(*GPathBuilder::Build([](GPathBuilder& bu) {
+        bu.addCircle({24, 32}, 16);
+    }));
+    canvas->clipPath(*GPathBuilder::Build([](GPathBuilder& bu) {
+        bu.addCircle({40, 32}, 16);
+    }));
+    canvas->drawRect(GRect::LTRB(0, 0, 64, 64), GPaint({0, 0, 1, 1}));
+
+    bool ok = *bitmap.getAddr(32, 32) == kBlue && *bitmap.getAddr(27, 32) == kBlue &&
+              *bitmap.getAddr(37, 32) == kBlue &&
+              *bitmap.getAddr(26, 22) == 0 && *bitmap.getAddr(37, 42) == 0 &&  // One circle only
+              *bitmap.getAddr(32, 17) == 0;  // Neither circle, though inside both bounds
+    free(bitmap.pixels());
+    return ok;
+}
+
+// Fills a stroke outline opaque into a fresh 100x100 bitmap (the caller frees it)
+static GBitmap fill_outline(const GPath& outline) {
+    GBitmap bitmap = alloc_bitmap(100, 100);
+    memset(bitmap.pixels(), 0, 100 * bitmap.rowBytes());
+    GCreateCanvas(bitmap)->drawPath(outline, GPaint({0, 0, 0, 1}));
+    return bitmap;
+}
+
+// A right angle keeps its miter; a near reversal, whose miter would be ~20x the half width,
+// falls back to a bevel under the default limit of 4
+static bool test_stroke_miter_falls_back_to_bevel() {
+    Stroker right(10, GStrokeJoin::kMiter, GStrokeCap::kButt);
+    const GPoint corner[] = {{10, 10}, {50, 10}, {50, 50}};
+    right.strokePolyline(corner, 3, false);
+    GBitmap bitmap = fill_outline(*right.detach());
+    bool ok = *bitmap.getAddr(54, 5) != 0;  // Past where a bevel would cut the corner off
+    free(bitmap.pixels());
+
+    Stroker sharp(10, GStrokeJoin::kMiter, GStrokeCap::kButt);
+    const GPoint reversal[] = {{10, 50}, {60, 50}, {10, 55}};
+    sharp.strokePolyline(reversal, 3, false);
+    return ok && sharp.detach()->bounds().right < 66;
+}
+
+// A square cap reaches half the width past each end; a butt cap stops at the end
+static bool test_stroke_square_and_butt_cap_extent() {
+    const GPoint line[] = {{20, 20}, {40, 20}};
+    Stroker butt(10, GStrokeJoin::kMiter, GStrokeCap::kButt);
+    butt.strokePolyline(line, 2, false);
+    Stroker square(10, GStrokeJoin::kMiter, GStrokeCap::kSquare);
+    square.strokePolyline(line, 2, false);
+
+    GRect b = butt.detach()->bounds();
+    GRect s = square.detach()->bounds();
+    auto near = [](float a, float b) { return a > b - 0.01f && a < b + 0.01f; };
+    return near(b.left, 20) && near(b.right, 40) && near(b.top, 15) && near(b.bottom, 25) &&
+           near(s.left, 15) && near(s.right, 45) && near(s.top, 15) && near(s.bottom, 25);
+}
+
+// A stroked quad covers the curve and a band around it with no gaps, for a gentle curve and
+// one that nearly turns back on itself
+static bool test_stroke_quad_has_no_gaps() {
+    const GPoint quads[][3] = {
+        {{10, 80}, {50, 0}, {90, 80}},
+        {{10, 50}, {95, 55}, {15, 60}},
+    };
+    for (const auto& q : quads) {
+        Stroker stroker(8, GStrokeJoin::kRound, GStrokeCap::kButt);
+        GPathBuilder bu;
+        bu.moveTo(q[0]);
+        bu.quadTo(q[1], q[2]);
+        stroker.strokePath(*bu.detach());
+        GBitmap bitmap = fill_outline(*stroker.detach());
+
+        bool ok = true;
+        for (int i = 1; i < 200 && ok; ++i) {
+            float t = i / 200.0f, u = 1 - t;
+            GPoint p = {u * u * q[0].x + 2 * u * t * q[1].x + t * t * q[2].x,
+                        u * u * q[0].y + 2 * u * t * q[1].y + t * t * q[2].y};
+            GVector d = {u * (q[1].x - q[0].x) + t * (q[2].x - q[1].x),
+                         u * (q[1].y - q[0].y) + t * (q[2].y - q[1].y)};
+            GVector n = {-d.y * 2.5f / d.length(), d.x * 2.5f / d.length()};
+            for (GPoint sample : {p, p + n, p - n}) {
+                ok = ok && *bitmap.getAddr(static_cast<int>(sample.x), static_cast<int>(sample.y)) != 0;
+            }
+        }
+        free(bitmap.pixels());
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// How many rows of column x have any color
+static int count_rows(const GBitmap& bitmap, int x) {
+    int rows = 0;
+    for (int y = 0; y < bitmap.height(); ++y) {
+        rows += *bitmap.getAddr(x, y) != 0;
+    }
+    return rows;
+}
+
+// Strokes up to one device pixel wide (width times the CTM's scale) are hairlines, one row
+// tall; anything wider is filled as an outline, which here covers two rows
+static bool test_stroke_hairline_cutoff() {
+    auto final = GCreateFinal();
+    auto line = GPathBuilder::Build([](GPathBuilder& bu) {
+        bu.moveTo(5, 10);
+        bu.lineTo(45, 10);
+    });
+    int rows[2];
+    const float widths[2] = {0.5f, 0.55f};
+    for (int i = 0; i < 2; ++i) {
+        GBitmap bitmap = alloc_bitmap(100, 40);
+        memset(bitmap.pixels(), 0, 40 * bitmap.rowBytes());
+        auto canvas = GCreateCanvas(bitmap);
+        canvas->scale(2, 2);
+        final->drawStroke(canvas.get(), *line, widths[i], GStrokeJoin::kMiter, GStrokeCap::kButt,
+                          GPaint({0, 0, 0, 1}));
+        rows[i] = count_rows(bitmap, 50);
+        free(bitmap.pixels());
+    }
+    return rows[0] == 1 && rows[1] == 2;
+}
+
+// Hairline and outline strokes, under a CTM the scene sets and one the canvas already has
+static void draw_stroke_scene(GCanvas* canvas) {
+    auto final = GCreateFinal();
+    auto path = GPathBuilder::Build([](GPathBuilder& bu) {
+        bu.moveTo(10, 20);
+        bu.quadTo(80, 0, 70, 90);
+        bu.cubicTo(40, 200, 150, 100, 140, 280);
+    });
+    GPaint aa({0.8f, 0.2f, 0.1f, 1});
+    aa.setAntiAlias(true);
+    final->drawStroke(canvas, *path, 0.8f, GStrokeJoin::kRound, GStrokeCap::kRound, aa);
+    final->drawStroke(canvas, *path, 0, GStrokeJoin::kRound, GStrokeCap::kRound,
+                      GPaint({0, 0, 1, 1}));
+    canvas->translate(5, 0);
+    final->drawStroke(canvas, *path, 6, GStrokeJoin::kMiter, GStrokeCap::kSquare,
+                      GPaint({0, 0.6f, 0.2f, 0.5f}));
+}
+
+// A recorded stroke draws exactly as it would have directly: the canvas it is played back onto
+// picks hairline or outline with the CTM it has then
+static bool test_stroke_recorded_matches_direct() {
+    const int width = 160, height = 300;
+    GRecordingCanvas recorder;
+    draw_stroke_scene(&recorder);
+    auto picture = recorder.finishRecording();
+
+    bool ok = true;
+    for (float scale : {1.0f, 1.5f}) {
+        GBitmap direct = alloc_bitmap(width, height);
+        GBitmap played = alloc_bitmap(width, height);
+        memset(direct.pixels(), 0, height * direct.rowBytes());
+        memset(played.pixels(), 0, height * played.rowBytes());
+        auto directCanvas = GCreateCanvas(direct);
+        directCanvas->scale(scale, scale);
+        draw_stroke_scene(directCanvas.get());
+        auto playedCanvas = GCreateCanvas(played);
+        playedCanvas->scale(scale, scale);
+        picture->playback(playedCanvas.get());
+        ok = ok && memcmp(direct.pixels(), played.pixels(), height * direct.rowBytes()) == 0;
+
+        if (scale == 1) {
+            memset(played.pixels(), 0, height * played.rowBytes());
+            picture->playbackInBands(played, 4);
+            ok = ok && memcmp(direct.pixels(), played.pixels(), height * direct.rowBytes()) == 0;
+        }
+        free(direct.pixels());
+        free(played.pixels());
+    }
+    return ok;
+}
+
+// Halves an opaque texture, averaging each 2x2 block, as a mip level is built
+static std::vector<GPixel> halve(const std::vector<GPixel>& src, int size) {
+    int half = size / 2;
+    std::vector<GPixel> dst(half * half);
+    for (int y = 0; y < half; ++y) {
+        for (int x = 0; x < half; ++x) {
+            const GPixel* p = &src[2 * y * size + 2 * x];
+            GPixel result = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                unsigned sum = ((p[0] >> shift) & 0xFF) + ((p[1] >> shift) & 0xFF) +
+                               ((p[size] >> shift) & 0xFF) + ((p[size + 1] >> shift) & 0xFF);
+                result |= ((sum + 2) >> 2) << shift;
+            }
+            dst[y * half + x] = result;
+        }
+    }
+    return dst;
+}
+
+// Fills a 64x64 bitmap with shader under translate(0.3) * scale(scale)
+static std::vector<GPixel> draw_scaled(std::shared_ptr<GShader> shader, float scale) {
+    GBitmap bitmap = alloc_bitmap(64, 64);
+    memset(bitmap.pixels(), 0, 64 * bitmap.rowBytes());
+    auto canvas = GCreateCanvas(bitmap);
+    canvas->translate(0.3f, 0.3f);
+    canvas->scale(scale, scale);
+    canvas->drawRect(GRect::LTRB(0, 0, 64 / scale, 64 / scale), GPaint(shader));
+    std::vector<GPixel> pixels(bitmap.pixels(), bitmap.pixels() + 64 * 64);
+    free(bitmap.pixels());
+    return pixels;
+}
+
+// A mipmapped texture drawn at 0.5x samples level 1 and at 0.25x level 2: it matches a plain
+// bilinear draw of that (hand-built) level at 1x, and not of the levels around it. The offset
+// keeps samples off texel centers, where every level would agree.
+static bool test_mip_level_choice() {
+    const int size = 128;
+    std::vector<GPixel> levels[4];
+    unsigned seed = 7;
+    for (int i = 0; i < size * size; ++i) {
+        seed = seed * 1103515245 + 12345;
+        levels[0].push_back(GPixel_PackARGB(255, seed >> 24, (seed >> 16) & 0xFF, (seed >> 8) & 0xFF));
+    }
+    for (int k = 1; k < 4; ++k) {
+        levels[k] = halve(levels[k - 1], size >> (k - 1));
+    }
+
+    GBitmap texture(size, size, size * sizeof(GPixel), levels[0].data(), true);
+    auto mipmap = GCreateBitmapShader(texture, GMatrix(), GTileMode::kClamp, GFilterQuality::kMipmap);
+    for (int expected : {1, 2}) {
+        float scale = 1.0f / (1 << expected);
+        std::vector<GPixel> drawn = draw_scaled(mipmap, scale);
+        for (int k = expected - 1; k <= expected + 1; ++k) {
+            int levelSize = size >> k;
+            GBitmap level(levelSize, levelSize, levelSize * sizeof(GPixel), levels[k].data(), true);
+            auto bilinear = GCreateBitmapShader(level, GMatrix(), GTileMode::kClamp,
+                                                GFilterQuality::kBilinear);
+            bool same = draw_scaled(bilinear, scale * (1 << k)) == drawn;
+            if (same != (k == expected)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Distance from p to the segment a-b
+static double distance_to_segment(double px, double py, GPoint a, GPoint b) {
+    double dx = b.x - a.x, dy = b.y - a.y;
+    double length2 = dx * dx + dy * dy;
+    double t = length2 > 0 ? ((px - a.x) * dx + (py - a.y) * dy) / length2 : 0;
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+    double ex = a.x + t * dx - px, ey = a.y + t * dy - py;
+    return sqrt(ex * ex + ey * ey);
+}
+
+// Flattening tight curves (a cubic that loops, one with a near cusp, and a quad that nearly
+// turns back) stays within tolerance: every point on the curve is that close to its own chord
+static bool test_flattening_within_tolerance() {
+    const GPoint curves[][4] = {
+        {{0, 0}, {300, 0}, {-200, 100}, {100, 100}},
+        {{10, 10}, {400, 300}, {-300, 300}, {90, 10}},
+        {{0, 0}, {500, 20}, {0, 40}, {0, 40}},
+    };
+    const int counts[] = {4, 4, 3};
+    const float tolerance = 0.25f;
+    for (int c = 0; c < 3; ++c) {
+        const GPoint* pts = curves[c];
+        int count = counts[c];
+        int segments = curveSegmentCount(pts, count, tolerance);
+        std::vector<GPoint> polyline(1, pts[0]);
+        forEachCurvePoint(pts, count, segments, [&](GPoint p) { polyline.push_back(p); });
+        if (static_cast<int>(polyline.size()) != segments + 1) {
+            return false;
+        }
+
+        const int samples = 20000;
+        for (int i = 0; i <= samples; ++i) {
+            double t = static_cast<double>(i) / samples, u = 1 - t;
+            double w[4] = {u * u * u, 3 * u * u * t, 3 * u * t * t, t * t * t};
+            if (count == 3) {
+                w[0] = u * u, w[1] = 2 * u * t, w[2] = t * t, w[3] = 0;
+            }
+            double x = 0, y = 0;
+            for (int k = 0; k < count; ++k) {
+                x += w[k] * pts[k].x;
+                y += w[k] * pts[k].y;
+            }
+            int chord = std::min(static_cast<int>(t * segments), segments - 1);
+            if (distance_to_segment(x, y, polyline[chord], polyline[chord + 1]) > tolerance * 1.01) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Shades the pixel at x, y of shader with an identity CTM
+static GPixel shade_pixel(GShader* shader, int x, int y) {
+    GPixel pixel = 0;
+    if (shader->setContext(GMatrix())) {
+        shader->shadeRow(x, y, 1, &pixel);
+    }
+    return pixel;
+}
+
+static bool near_pixel(GPixel pixel, int a, int r, int g, int b) {
+    return abs(GPixel_GetA(pixel) - a) <= 1 && abs(GPixel_GetR(pixel) - r) <= 1 &&
+           abs(GPixel_GetG(pixel) - g) <= 1 && abs(GPixel_GetB(pixel) - b) <= 1;
+}
+
+// Stops far narrower than a color-table entry still show up, and pixels on a stop get its color.
+// Pixel x sits at t = x / 10000.
+static bool test_gradient_stops_are_exact() {
+    const GColor colors[] = {{0, 0, 0, 1}, {0, 0, 0, 1}, {1, 1, 1, 1}, {1, 0, 0, 1}, {0, 0, 1, 1}};
+    const float pos[] = {0, 0.5f, 0.5004f, 0.7f, 1};
+    auto shader = GCreateLinearGradient({0.5f, 0}, {10000.5f, 0}, colors, pos, 5);
+    GPixel mid = shade_pixel(shader.get(), 5002, 0);
+    return GPixel_GetR(mid) > 120 && GPixel_GetR(mid) < 136 &&
+           near_pixel(shade_pixel(shader.get(), 4999, 0), 255, 0, 0, 0) &&
+           near_pixel(shade_pixel(shader.get(), 5005, 0), 255, 255, 255, 255) &&
+           near_pixel(shade_pixel(shader.get(), 7000, 0), 255, 255, 0, 0) &&
+           near_pixel(shade_pixel(shader.get(), 10000, 0), 255, 0, 0, 255);
+}
+
+// Positions outside [0, 1] are pinned and decreasing ones raised to their neighbor, so
+// {-1, 0.8, 0.2, 2} draws like {0, 0.8, 0.8, 1}
+static bool test_gradient_positions_are_sanitized() {
+    const GColor colors[] = {{1, 0, 0, 1}, {0, 1, 0, 1}, {0, 0, 1, 1}, {1, 1, 1, 1}};
+    const float bad[] = {-1, 0.8f, 0.2f, 2};
+    const float good[] = {0, 0.8f, 0.8f, 1};
+    auto badShader = GCreateLinearGradient({0.5f, 0}, {1000.5f, 0}, colors, bad, 4);
+    auto goodShader = GCreateLinearGradient({0.5f, 0}, {1000.5f, 0}, colors, good, 4);
+    for (int x = 0; x <= 1000; x += 50) {
+        if (shade_pixel(badShader.get(), x, 0) != shade_pixel(goodShader.get(), x, 0)) {
+            return false;
+        }
+    }
+    return near_pixel(shade_pixel(badShader.get(), 900, 0), 255, 128, 128, 255);
+}
+
+// Coons patches that share an edge must share its vertices exactly, or rounding leaves
+// cracks between them: the shared edge is the first patch's bottom row and the second's top
+static bool test_coons_shared_edge_is_exact() {
+    const GPoint upper[8] = {
+        {0.1f, 0.3f}, {33.7f, -9.1f}, {70.3f, 0.7f}, {81.9f, 31.3f},
+        {69.9f, 60.1f}, {35.3f, 71.7f}, {0.9f, 59.3f}, {-11.3f, 29.9f},
+    };
+    const GPoint lower[8] = {
+        upper[6], upper[5], upper[4], {77.7f, 91.1f},
+        {71.3f, 120.7f}, {36.1f, 131.9f}, {1.7f, 119.3f}, {-9.7f, 90.3f},
+    };
+    const int level = 13;
+    const int side = level + 2;
+
+    QuadTessellation a, b;
+    a.evaluateCoons(upper, nullptr, level);
+    b.evaluateCoons(lower, nullptr, level);
+    const GPoint* bottom = a.verts() + (side - 1) * side;
+    const GPoint* top = b.verts();
+    for (int x = 0; x < side; ++x) {
+        if (bottom[x].x != top[x].x || bottom[x].y != top[x].y) {
+            return false;
+        }
+    }
+    const GPoint* last = a.verts() + side * side - 1;
+    return last->x == upper[4].x && last->y == upper[4].y;  // The corner is the curve's end
+}
+
+static void draw_picture_scene(GCanvas* canvas) {
+    auto shared = GPathBuilder::Build([](GPathBuilder& bu) {
+        bu.moveTo(4, 4);
+        bu.quadTo(60, 0, 56, 40);
+        bu.lineTo(8, 56);
+    });
+    canvas->drawPath(*shared, GPaint({1, 0.5f, 0, 1}));
+    {
+        // Not owned by a shared_ptr, and gone before playback
+        GPath path({{10, 30}, {50, 10}, {60, 60}}, {kMove, kLine, kLine});
+        canvas->drawPath(path, GPaint({0, 0, 1, 0.5f}));
+    }
+    canvas->translate(5, 3);
+    canvas->drawRect(GRect::LTRB(20, 20, 40, 40), GPaint({0, 1, 0, 0.75f}));
+}
+
+// Playing a picture back draws the same pixels as the recorded calls, even for paths the
+// caller let go of after recording
+static bool test_picture_playback_matches_direct() {
+    GBitmap direct = alloc_bitmap(64, 64);
+    GBitmap played = alloc_bitmap(64, 64);
+    memset(direct.pixels(), 0, 64 * direct.rowBytes());
+    memset(played.pixels(), 0, 64 * played.rowBytes());
+
+    draw_picture_scene(GCreateCanvas(direct).get());
+    GRecordingCanvas recorder;
+    draw_picture_scene(&recorder);
+    recorder.finishRecording()->playback(GCreateCanvas(played).get());
+
+    bool ok = memcmp(direct.pixels(), played.pixels(), 64 * direct.rowBytes()) == 0;
+    free(direct.pixels());
+    free(played.pixels());
+    return ok;
+}
+
+// Draws scene on a MyCanvas and a 4-thread ParallelCanvas, several bands tall, and checks that
+// they match pixel for pixel
+static bool parallel_matches_serial(void (*scene)(GCanvas*)) {
+    const int width = 160, height = 300;
+    GBitmap serial = alloc_bitmap(width, height);
+    GBitmap parallel = alloc_bitmap(width, height);
+    memset(serial.pixels(), 0, height * serial.rowBytes());
+    memset(parallel.pixels(), 0, height * parallel.rowBytes());
+    scene(GCreateCanvas(serial).get());
+    scene(GCreateParallelCanvas(parallel, 4).get());
+
+    bool ok = memcmp(serial.pixels(), parallel.pixels(), height * serial.rowBytes()) == 0;
+    free(serial.pixels());
+    free(parallel.pixels());
+    return ok;
+}
+
+static std::shared_ptr<GPath> star_path() {
+    return GPathBuilder::Build([](GPathBuilder& bu) {
+        bu.moveTo(80, 5);
+        bu.lineTo(140, 290);
+        bu.quadTo(0, 120, 155, 110);
+        bu.cubicTo(100, 300, 0, 250, 5, 100);
+        bu.lineTo(80, 5);
+    });
+}
+
+static void draw_parallel_path(GCanvas* canvas) {
+    GPaint paint({0.2f, 0.6f, 1, 0.8f});
+    canvas->drawPath(*star_path(), paint);
+}
+
+static void draw_parallel_path_aa(GCanvas* canvas) {
+    GPaint paint(GCreateLinearGradient({0, 0}, {160, 300}, {1, 0, 0, 1}, {0, 0, 1, 0.5f}));
+    paint.setAntiAlias(true);
+    canvas->rotate(0.05f);
+    canvas->drawPath(*star_path(), paint);
+}
+
+static void draw_parallel_clip_path(GCanvas* canvas) {
+    canvas->save();
+    canvas->clipPath(*star_path());
+    canvas->drawRect(GRect::LTRB(0, 0, 160, 300), GPaint({0.9f, 0.4f, 0.1f, 1}));
+    GPaint aa({0, 0.5f, 0.5f, 0.6f});
+    aa.setAntiAlias(true);
+    canvas->drawPath(*GPathBuilder::Build([](GPathBuilder& bu) {
+        bu.addCircle({70, 150}, 60.5f);
+    }), aa);
+    canvas->restore();
+}
+
+static void draw_parallel_convex(GCanvas* canvas) {
+    const GPoint pts[] = {{10.3f, 3.7f}, {150.5f, 60.2f}, {120.8f, 296.4f}, {4.1f, 200.9f}};
+    canvas->drawConvexPolygon(pts, 4, GPaint({0.3f, 1, 0.3f, 0.7f}));
+    GPaint aa({1, 0, 1, 0.5f});
+    aa.setAntiAlias(true);
+    canvas->translate(7.25f, 3.5f);
+    canvas->drawConvexPolygon(pts, 4, aa);
+}
+
+// Shades a fixed color and isn't a CopyableShader, so parallel meshes can't copy it
+class PlainShader : public GShader {
+public:
+    bool isOpaque() override { return false; }
+    bool setContext(const GMatrix&) override { return true; }
+    void shadeRow(int x, int y, int count, GPixel row[]) override {
+        for (int i = 0; i < count; ++i) {
+            row[i] = GPixel_PackARGB(128, (x + i) & 127, y & 127, 64);
+        }
+    }
+};
+
+// Bitmap-textured quads share per-worker texture copies from one draw to the next; the plain
+// shader's quad falls back to drawing its bands serially
+static void draw_parallel_mesh(GCanvas* canvas) {
+    static GPixel texels[8 * 8];
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            texels[y * 8 + x] = GPixel_PackARGB(255, x * 32, y * 32, (x ^ y) * 32);
+        }
+    }
+    GBitmap texture(8, 8, 8 * sizeof(GPixel), texels, true);
+    GPaint bitmapPaint(GCreateBitmapShader(texture, GMatrix(), GTileMode::kRepeat,
+                                           GFilterQuality::kBilinear));
+    GPaint plainPaint(std::make_shared<PlainShader>());
+
+    const GPoint verts[4] = {{3.5f, 2.25f}, {120.5f, 20.75f}, {110.25f, 250.5f}, {-4.5f, 230.75f}};
+    const GColor colors[4] = {{1, 1, 1, 1}, {1, 0, 0, 0.5f}, {0, 1, 0, 1}, {0, 0, 1, 0.75f}};
+    const GPoint texs[4] = {{0, 0}, {24, 0}, {24, 40}, {0, 40}};
+    canvas->drawQuad(verts, colors, texs, 9, bitmapPaint);
+    canvas->translate(30.5f, 40.25f);
+    canvas->drawQuad(verts, nullptr, texs, 7, bitmapPaint);
+    canvas->translate(-20, 10);
+    canvas->drawQuad(verts, colors, texs, 5, plainPaint);
+}
+
+// Band-parallel drawing matches serial drawing for each kind of fill
+static bool test_parallel_mesh_matches_serial() {
+    return parallel_matches_serial(draw_parallel_mesh);
+}
+static bool test_parallel_path_matches_serial() {
+    return parallel_matches_serial(draw_parallel_path);
+}
+static bool test_parallel_path_aa_matches_serial() {
+    return parallel_matches_serial(draw_parallel_path_aa);
+}
+static bool test_parallel_clip_path_matches_serial() {
+    return parallel_matches_serial(draw_parallel_clip_path);
+}
+static bool test_parallel_convex_matches_serial() {
+    return parallel_matches_serial(draw_parallel_convex);
+}
+
+// A whole frame: a clear, then clipped, antialiased, gradient, mesh and convex draws
+static void draw_banded_scene(GCanvas* canvas) {
+    canvas->clear({0.1f, 0.2f, 0.3f, 1});
+    draw_parallel_clip_path(canvas);
+    canvas->save();
+    draw_parallel_path_aa(canvas);
+    canvas->restore();
+    canvas->save();
+    draw_parallel_convex(canvas);
+    canvas->restore();
+    draw_parallel_mesh(canvas);
+}
+
+// Replaying a picture band by band, on threadCount threads, draws the same frame as drawing
+// it directly
+static bool banded_playback_matches_direct(int threadCount) {
+    const int width = 160, height = 300;
+    GBitmap direct = alloc_bitmap(width, height);
+    GBitmap banded = alloc_bitmap(width, height);
+    memset(direct.pixels(), 0, height * direct.rowBytes());
+    memset(banded.pixels(), 0, height * banded.rowBytes());
+
+    draw_banded_scene(GCreateCanvas(direct).get());
+    GRecordingCanvas recorder;
+    draw_banded_scene(&recorder);
+    recorder.finishRecording()->playbackInBands(banded, threadCount);
+
+    bool ok = memcmp(direct.pixels(), banded.pixels(), height * direct.rowBytes()) == 0;
+    free(direct.pixels());
+    free(banded.pixels());
+    return ok;
+}
+
+static bool test_picture_bands_match_direct() {
+    return banded_playback_matches_direct(1) && banded_playback_matches_direct(4);
+}
+
+// Culled playback skips draws that miss the cull rect, draws those that reach it as usual,
+// and doesn't record draws that miss the clip at all
+static bool test_picture_cull_skips_draws() {
+    GRecordingCanvas recorder;
+    recorder.drawRect(GRect::LTRB(0, 0, 10, 10), GPaint({1, 0, 0, 1}));
+    recorder.translate(50, 0);
+    recorder.drawRect(GRect::LTRB(0, 0, 10, 10), GPaint({0, 1, 0, 1}));
+    recorder.clipRect(GRect::LTRB(0, 0, 20, 20));
+    recorder.drawRect(GRect::LTRB(30, 30, 40, 40), GPaint({0, 0, 1, 1}));
+    auto picture = recorder.finishRecording();
+    if (picture->countCommands() != 4) {  // concat and clip, and the two visible rects
+        return false;
+    }
+
+    GBitmap bitmap = alloc_bitmap(64, 16);
+    memset(bitmap.pixels(), 0, 16 * bitmap.rowBytes());
+    picture->playback(GCreateCanvas(bitmap).get(), GRect::LTRB(0, 0, 32, 16));
+    bool ok = *bitmap.getAddr(5, 5) == GPixel_PackARGB(255, 255, 0, 0) &&
+              *bitmap.getAddr(55, 5) == 0;
+    free(bitmap.pixels());
+    return ok;
+}
+
+// A mesh too big for one arena block gets a block of its own and plays back intact
+static bool test_picture_record_larger_than_block() {
+    const int columns = 64, rows = 32;
+    std::vector<GPoint> verts;
+    std::vector<GColor> colors;
+    for (int y = 0; y <= rows; ++y) {
+        for (int x = 0; x <= columns; ++x) {
+            verts.push_back({x * 2.5f, y * 2.0f});
+            colors.push_back({x / float(columns), y / float(rows), 0.5f, 1});
+        }
+    }
+    std::vector<int> indices;
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < columns; ++x) {
+            int i = y * (columns + 1) + x;
+            indices.insert(indices.end(), {i, i + 1, i + columns + 1, i + 1, i + columns + 2, i + columns + 1});
+        }
+    }
+    int count = static_cast<int>(indices.size() / 3);
+    auto scene = [&](GCanvas* canvas) {
+        canvas->drawRect(GRect::LTRB(2, 2, 20, 20), GPaint({1, 1, 0, 1}));
+        canvas->drawMesh(verts.data(), colors.data(), nullptr, count, indices.data(), GPaint());
+        canvas->drawRect(GRect::LTRB(100, 40, 150, 60), GPaint({0, 1, 1, 0.5f}));
+    };
+
+    const int width = 160, height = 64;
+    GBitmap direct = alloc_bitmap(width, height);
+    GBitmap played = alloc_bitmap(width, height);
+    memset(direct.pixels(), 0, height * direct.rowBytes());
+    memset(played.pixels(), 0, height * played.rowBytes());
+    scene(GCreateCanvas(direct).get());
+    GRecordingCanvas recorder;
+    scene(&recorder);
+    recorder.finishRecording()->playback(GCreateCanvas(played).get());
+
+    bool ok = memcmp(direct.pixels(), played.pixels(), height * direct.rowBytes()) == 0;
+    free(direct.pixels());
+    free(played.pixels());
+    return ok;
+}
+
+struct GTestRec {
+    bool        (*fProc)();
+    const char* fName;
+};
+
+static const GTestRec gTestRecs[] = {
+    { test_voronoi_far_away, "voronoi_far_away" },
+    { test_voronoi_huge_coordinates, "voronoi_huge_coordinates" },
+    { test_colormatrix_alpha_zeroing_chain, "colormatrix_alpha_zeroing_chain" },
+    { test_colormatrix_fused_copy_keeps_real_shader, "colormatrix_fused_copy_keeps_real_shader" },
+    { test_blend_row_matches_scalar, "blend_row_matches_scalar" },
+    { test_aa_half_pixel_edge_coverage, "aa_half_pixel_edge_coverage" },
+    { test_aa_interior_matches_aliased, "aa_interior_matches_aliased" },
+    { test_clip_save_restore, "clip_save_restore" },
+    { test_clip_rotated_rect, "clip_rotated_rect" },
+    { test_clip_nested_paths_intersect, "clip_nested_paths_intersect" },
+    { test_stroke_miter_falls_back_to_bevel, "stroke_miter_falls_back_to_bevel" },
+    { test_stroke_square_and_butt_cap_extent, "stroke_square_and_butt_cap_extent" },
+    { test_stroke_quad_has_no_gaps, "stroke_quad_has_no_gaps" },
+    { test_stroke_hairline_cutoff, "stroke_hairline_cutoff" },
+    { test_stroke_recorded_matches_direct, "stroke_recorded_matches_direct" },
+    { test_mip_level_choice, "mip_level_choice" },
+    { test_flattening_within_tolerance, "flattening_within_tolerance" },
+    { test_gradient_stops_are_exact, "gradient_stops_are_exact" },
+    { test_gradient_positions_are_sanitized, "gradient_positions_are_sanitized" },
+    { test_coons_shared_edge_is_exact, "coons_shared_edge_is_exact" },
+    { test_picture_playback_matches_direct, "picture_playback_matches_direct" },
+    { test_parallel_mesh_matches_serial, "parallel_mesh_matches_serial" },
+    { test_parallel_path_matches_serial, "parallel_path_matches_serial" },
+    { test_parallel_path_aa_matches_serial, "parallel_path_aa_matches_serial" },
+    { test_parallel_clip_path_matches_serial, "parallel_clip_path_matches_serial" },
+    { test_parallel_convex_matches_serial, "parallel_convex_matches_serial" },
+    { test_picture_bands_match_direct, "picture_bands_match_direct" },
+    { test_picture_cull_skips_draws, "picture_cull_skips_draws" },
+    { test_picture_record_larger_than_block, "picture_record_larger_than_block" },
+};
+
+int main(int argc, const char* argv[]) {
+    int failures = 0;
+    for (const GTestRec& rec : gTestRecs) {
+        bool ok = rec.fProc();
+        printf("%-44s %s\n", rec.fName, ok ? "ok" : "FAILED");
+        failures += !ok;
+    }
+    printf("%d of %d tests failed\n", failures, static_cast<int>(sizeof(gTestRecs) / sizeof(gTestRecs[0])));
+    return failures ? 1 : 0;
+}
@@ -19,8 +19,8 @@ public:
     virtual ~GCanvas() {}
 
     /**
-     *  Save off a copy of the canvas state (CTM), to be later used if the balancing call to
-     *  restore() is made. Calls to save/restore can be nested:
+     *  Save off a copy of the canvas state (CTM and clip), to be later used if the balancing call
+     *  to restore() is made. Calls to save/restore can be nested:
      *  save();
      *      save();
      *          concat(...);    // this modifies the CTM
@@ -32,8 +32,8 @@ public:
     virtual void save() = 0;
 
     /**
-     *  Copy the canvas state (CTM) that was record in the correspnding call to save() back into
-     *  the canvas. It is an error to call restore() if there has been no previous call to save().
+     *  Copy the canvas state (CTM and clip) that was record in the correspnding call to save()
+     *  back into the canvas. It is an error to call restore() if there has been no previous call to save().
      */
     virtual void restore() = 0;
 
@@ -45,6 +45,19 @@ public:
      */
     virtual void concat(const GMatrix& matrix) = 0;
 
+    /**
+     *  Intersect the current clip with the rectangle, mapped by the CTM. Subsequent draws only
+     *  affect pixels whose centers are inside the clip (using the same "containment" rule as
+     *  drawRect). The clip is part of the canvas state saved by save() and reset by restore().
+     */
+    virtual void clipRect(const GRect&) = 0;
+
+    /**
+     *  Intersect the current clip with the path, mapped by the CTM and interpreted using
+     *  winding-fill (non-zero winding), just like drawPath.
+     */
+    virtual void clipPath(const GPath&) = 0;
+
     /**
      *  Fill the entire canvas with the specified color, using kSrc porter-duff mode.
      */
@@ -166,6 +179,13 @@ public:
  */
 std::unique_ptr<GCanvas> GCreateCanvas(const GBitmap& bitmap);
 
+/**
+ *  Same as GCreateCanvas, but the returned canvas rasterizes each draw in horizontal bands
+ *  spread across threadCount threads (threadCount <= 0 means one per hardware thread).
+ *  Draws still happen in order, and the pixels match GCreateCanvas exactly.
+ */
+std::unique_ptr<GCanvas> GCreateParallelCanvas(const GBitmap& bitmap, int threadCount = 0);
+
 /**
  *  Implement this, drawing into the provided canvas, and returning the title of your artwork.
  */
@@ -44,6 +44,20 @@ struct GColorMatrix {
     }
 };
 
+// How a stroke turns the corner where two segments meet
+enum class GStrokeJoin {
+    kRound,  // an arc centered on the corner
+    kMiter,  // the outer edges extended until they meet (bevelled if that is too far)
+    kBevel,  // a straight line across the outer edges' ends
+};
+
+// How a stroke ends at the two ends of an open contour
+enum class GStrokeCap {
+    kButt,    // flat, through the end point
+    kRound,   // a half circle centered on the end point
+    kSquare,  // flat, half the width past the end point
+};
+
 /**
  * Override and implement these methods. You must implement GCreateFinal() to return your subclass.
  *
@@ -123,6 +137,24 @@ public:
         return nullptr;
     }
 
+    /**
+     *  Construct a path that, when drawn, will look like a stroke of every contour in the path,
+     *  curves included, with the specified joins and caps.
+     *  - width is the thickness of the stroke that should be centered on the path
+     *  - a contour is stroked closed (joined rather than capped) if it ends where it started
+     */
+    virtual std::shared_ptr<GPath> strokePath(const GPath&, float width, GStrokeJoin, GStrokeCap) {
+        return nullptr;
+    }
+
+    /**
+     *  Draw the stroke of the path (as strokePath would build it) with the paint. Strokes no
+     *  more than a pixel wide on the device (including width 0) may be drawn as hairlines:
+     *  lines exactly one pixel wide, with no joins or caps.
+     */
+    virtual void drawStroke(GCanvas*, const GPath&, float width, GStrokeJoin, GStrokeCap,
+                            const GPaint&) {}
+
     /*
      *  Draw the corresponding mesh constructed from a quad with each side defined by a
      *  quadratic bezier, evaluating them to produce "level" interior lines (same convention
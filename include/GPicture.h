@@ -0,0 +1,125 @@
+/*
+ *  Copyright 2024 Shristi
+ */
+
+#ifndef GPicture_DEFINED
+#define GPicture_DEFINED
+
+#include "GBitmap.h"
+#include "GCanvas.h"
+#include "GMatrix.h"
+#include "GPaint.h"
+#include "GPath.h"
+#include "GRect.h"
+#include "GStrokeCanvas.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ *  An immutable list of canvas commands, captured by GRecordingCanvas. A picture can be played
+ *  back any number of times, onto any canvas, with whatever CTM that canvas currently has.
+ *
+ *  Every draw is recorded with the bounds of the pixels it can touch, in the picture's own
+ *  coordinates, so playback can skip the draws that miss a region and replay separate regions
+ *  independently of each other.
+ */
+class GPicture {
+public:
+    /**
+     *  Issue the recorded commands to the canvas, in order. The canvas' CTM and save-stack are
+     *  the same afterwards as they were before, even if the recording left saves unbalanced.
+     */
+    void playback(GCanvas* canvas) const;
+
+    /**
+     *  Same, but skip the draws whose recorded bounds miss cull (in the picture's coordinates,
+     *  before the canvas' CTM). State changes and clear are always issued. Drawing one tile of
+     *  a picture this way costs only the draws that reach the tile.
+     */
+    void playback(GCanvas* canvas, const GRect& cull) const;
+
+    /**
+     *  Draw the picture into bitmap, one pixel per picture unit, producing the same pixels as
+     *  playback(GCreateCanvas(bitmap).get()). Rather than one walk over the whole frame, the
+     *  rows are split into bands that are replayed independently, on threadCount threads (0
+     *  means one per core): each band issues, in recording order and clipped to its rows, only
+     *  the draws whose bounds reach it. Shaders are copied for the extra threads; if a paint's
+     *  shader can't be copied, the bands all run on the calling thread instead.
+     */
+    void playbackInBands(const GBitmap& bitmap, int threadCount = 0) const;
+
+    int countCommands() const { return fCommandCount; }
+
+private:
+    friend class GRecordingCanvas;
+
+    // Walks the commands onto canvas with these paints (the picture's own, or copies for
+    // another thread), skipping draws that miss cull if it is set. If band is set, it is the
+    // bitmap under the canvas and clear only fills cull's rows of it.
+    void replay(GCanvas* canvas, const GRect* cull, const std::vector<GPaint>& paints,
+                const GBitmap* band) const;
+
+    // Commands are packed back to back into an arena of fixed-size blocks of words: a record
+    // never spans two blocks (one too big for a block gets a block of its own), so recording
+    // never moves a record already written. Each command is an op word and a size word (the
+    // record's length in words), then the op's record and any trailing arrays, all padded to
+    // whole words.
+    struct Block {
+        std::unique_ptr<uint32_t[]> words;
+        size_t                      capacity;
+        size_t                      used;
+    };
+
+    std::vector<Block>                        fBlocks;
+    std::vector<GPaint>                       fPaints;
+    std::vector<std::shared_ptr<const GPath>> fPaths;
+    int                                       fCommandCount = 0;
+};
+
+/**
+ *  A canvas that draws nothing, but remembers every call so it can be replayed later through
+ *  the GPicture returned by finishRecording(). Strokes are recorded as strokes, so the canvas
+ *  they are played back onto decides how to draw them.
+ */
+class GRecordingCanvas : public GStrokeCanvas {
+public:
+    GRecordingCanvas();
+
+    void save() override;
+    void restore() override;
+    void concat(const GMatrix&) override;
+    void clipRect(const GRect&) override;
+    void clipPath(const GPath&) override;
+
+    void clear(const GColor&) override;
+    void drawRect(const GRect&, const GPaint&) override;
+    void drawConvexPolygon(const GPoint[], int count, const GPaint&) override;
+    void drawPath(const GPath&, const GPaint&) override;
+    void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[],
+                  int count, const int indices[], const GPaint&) override;
+    void drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4],
+                  int level, const GPaint&) override;
+    void drawStroke(const GPath&, float width, GStrokeJoin, GStrokeCap, const GPaint&) override;
+
+    /**
+     *  Return the commands recorded so far as a picture, and start a new, empty recording.
+     */
+    std::shared_ptr<GPicture> finishRecording();
+
+private:
+    template <typename T> T* append(int op, size_t trailingBytes = 0);
+    bool drawBounds(const GPoint pts[], int count, GRect* bounds) const;
+    int recordPaint(const GPaint&);
+    int recordPath(const GPath&);
+    void reset();
+
+    std::unique_ptr<GPicture> fPicture;
+
+    // The recorded CTM and the bounds of the recorded clip (in picture coordinates) at each
+    // save level; back() is the current one
+    std::vector<GMatrix> fMatrices;
+    std::vector<GRect>   fClipBounds;
+};
+
+#endif
@@ -19,6 +19,12 @@ enum class GTileMode {
     kMirror,
 };
 
+enum class GFilterQuality {
+    kNearest,   // the texel containing each sample point
+    kBilinear,  // weighted average of the 2x2 texels nearest each sample point
+    kMipmap,    // bilinear, from a pre-shrunk copy of the bitmap when it is drawn minified
+};
+
 /**
  *  GShaders create colors to fill whatever geometry is being drawn to a GCanvas.
  */
@@ -43,9 +49,13 @@ public:
 /**
  *  Return a subclass of GShader that draws the specified bitmap and the local matrix.
  *  Returns null if the subclass can not be created.
+ *
+ *  Mipmap levels are built the first time the shader is drawn minified, and kept with the
+ *  shader, so the bitmap's pixels must not change while the shader is in use.
  */
 std::shared_ptr<GShader> GCreateBitmapShader(const GBitmap&, const GMatrix& localMatrix,
-                                             GTileMode = GTileMode::kClamp);
+                                             GTileMode = GTileMode::kClamp,
+                                             GFilterQuality = GFilterQuality::kNearest);
 
 /**
  *  Return a subclass of GShader that draws the specified gradient of [count] colors between
@@ -61,6 +71,17 @@ std::shared_ptr<GShader> GCreateBitmapShader(const GBitmap&, const GMatrix& loca
 std::shared_ptr<GShader> GCreateLinearGradient(GPoint p0, GPoint p1, const GColor[], int count,
                                                GTileMode = GTileMode::kClamp);
 
+/**
+ *  Same as above, but color[i] is placed at pos[i] along the line from p0 (0) to p1 (1) rather
+ *  than evenly. pos[] must be non-decreasing; equal neighbors make a hard edge. A null pos
+ *  means evenly spaced. Positions are pinned to [0, 1], and one smaller than the position
+ *  before it is raised to match. Before the first stop and after the last, the gradient keeps
+ *  that stop's color.
+ */
+std::shared_ptr<GShader> GCreateLinearGradient(GPoint p0, GPoint p1, const GColor[],
+                                               const float pos[], int count,
+                                               GTileMode = GTileMode::kClamp);
+
 static inline std::shared_ptr<GShader> GCreateLinearGradient(GPoint p0, GPoint p1,
                                                              const GColor& c0, const GColor& c1,
                                                              GTileMode mode = GTileMode::kClamp) {
@@ -0,0 +1,27 @@
+/*
+ *  Copyright 2024 Shristi
+ */
+
+#ifndef GStrokeCanvas_DEFINED
+#define GStrokeCanvas_DEFINED
+
+#include "GCanvas.h"
+#include "GFinal.h"
+#include "GPaint.h"
+#include "GPath.h"
+
+/**
+ *  A canvas that draws strokes itself, rather than having their outlines filled for it.
+ *  GFinal::drawStroke and picture playback both hand strokes to such a canvas, so whatever it
+ *  decides (e.g. to draw thin strokes as hairlines) is decided the same way whether the stroke
+ *  is drawn directly or recorded first.
+ */
+class GStrokeCanvas : public GCanvas {
+public:
+    /**
+     *  Draw the stroke of the path with the paint, as GFinal::drawStroke describes.
+     */
+    virtual void drawStroke(const GPath&, float width, GStrokeJoin, GStrokeCap, const GPaint&) = 0;
+};
+
+#endif
@@ -0,0 +1,273 @@
+/*
+ *  Copyright 2024 Shristi
+ */
+
+#ifndef _MY_BLEND_H_
+#define _MY_BLEND_H_
+
+#include "my_utils.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Row-level Porter-Duff kernels. Each mode is written once in terms of per-channel
+// operations, then run 8 pixels at a time (AVX2), 4 at a time (SSE2) and finally one pixel
+// at a time with the scalar blend_* functions, which they match bit for bit.
+//
+// The vector versions unpack each channel into a 16-bit lane. Premultiplied inputs keep every
+// intermediate below 65025 + 128, and divide255's (x + 128) * 257 >> 16 is a single mulhi.
+
+#if defined(__SSE2__)
+static inline void vstore(GPixel* p, __m128i v) { _mm_storeu_si128((__m128i*)p, v); }
+static inline __m128i vunpacklo(__m128i v) { return _mm_unpacklo_epi8(v, _mm_setzero_si128()); }
+static inline __m128i vunpackhi(__m128i v) { return _mm_unpackhi_epi8(v, _mm_setzero_si128()); }
+static inline __m128i vpack(__m128i lo, __m128i hi) { return _mm_packus_epi16(lo, hi); }
+static inline __m128i vadd(__m128i a, __m128i b) { return _mm_add_epi16(a, b); }
+static inline __m128i vmul(__m128i a, __m128i b) { return _mm_mullo_epi16(a, b); }
+static inline __m128i vinv(__m128i a) { return _mm_sub_epi16(_mm_set1_epi16(255), a); }
+static inline __m128i vdiv255(__m128i a) {
+    return _mm_mulhi_epu16(_mm_add_epi16(a, _mm_set1_epi16(128)), _mm_set1_epi16(257));
+}
+// Broadcast each pixel's alpha (lane 3 of its 4 lanes) across its channels
+static inline __m128i valpha(__m128i v) {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xFF), 0xFF);
+}
+#endif
+
+#if defined(__AVX2__)
+static inline void vstore(GPixel* p, __m256i v) { _mm256_storeu_si256((__m256i*)p, v); }
+static inline __m256i vunpacklo(__m256i v) { return _mm256_unpacklo_epi8(v, _mm256_setzero_si256()); }
+static inline __m256i vunpackhi(__m256i v) { return _mm256_unpackhi_epi8(v, _mm256_setzero_si256()); }
+static inline __m256i vpack(__m256i lo, __m256i hi) { return _mm256_packus_epi16(lo, hi); }
+static inline __m256i vadd(__m256i a, __m256i b) { return _mm256_add_epi16(a, b); }
+static inline __m256i vmul(__m256i a, __m256i b) { return _mm256_mullo_epi16(a, b); }
+static inline __m256i vinv(__m256i a) { return _mm256_sub_epi16(_mm256_set1_epi16(255), a); }
+static inline __m256i vdiv255(__m256i a) {
+    return _mm256_mulhi_epu16(_mm256_add_epi16(a, _mm256_set1_epi16(128)), _mm256_set1_epi16(257));
+}
+static inline __m256i valpha(__m256i v) {
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v, 0xFF), 0xFF);
+}
+#endif
+
+// Per-channel formulas: S/D are the src/dst channels, Sa/Da the src/dst alphas
+struct SrcOverKernel {
+    template <typename V> static V apply(V S, V D, V Sa, V Da) { return vadd(S, vdiv255(vmul(D, vinv(Sa)))); }
+};
+struct DstOverKernel {
+    template <typename V> static V apply(V S, V D, V Sa, V Da) { return vadd(D, vdiv255(vmul(S, vinv(Da)))); }
+};
+struct SrcInKernel {
+    template <typename V> static V apply(V S, V D, V Sa, V Da) { return vdiv255(vmul(S, Da)); }
+};
+struct DstInKernel {
+    template <typename V> static V apply(V S, V D, V Sa, V Da) { return vdiv255(vmul(D, Sa)); }
+};
+struct SrcOutKernel {
+    template <typename V> static V apply(V S, V D, V Sa, V Da) { return vdiv255(vmul(S, vinv(Da))); }
+};
+struct DstOutKernel {
+    template <typename V> static V apply(V S, V D, V Sa, V Da) { return vdiv255(vmul(D, vinv(Sa))); }
+};
+struct SrcATopKernel {
+    template <typename V> static V apply(V S, V D, V Sa, V Da) {
+        return vdiv255(vadd(vmul(S, Da), vmul(D, vinv(Sa))));
+    }
+};
+struct DstATopKernel {
+    template <typename V> static V apply(V S, V D, V Sa, V Da) {
+        return vdiv255(vadd(vmul(D, Sa), vmul(S, vinv(Da))));
+    }
+};
+struct XorKernel {
+    template <typename V> static V apply(V S, V D, V Sa, V Da) {
+        return vdiv255(vadd(vmul(D, vinv(Sa)), vmul(S, vinv(Da))));
+    }
+};
+
+// Blend one register's worth of pixels (2 pixels per half for SSE2, 4 for AVX2)
+template <typename Kernel, typename V>
+inline V blendPixels(V src, V dst) {
+    V sLo = vunpacklo(src), sHi = vunpackhi(src);
+    V dLo = vunpacklo(dst), dHi = vunpackhi(dst);
+    V lo = Kernel::apply(sLo, dLo, valpha(sLo), valpha(dLo));
+    V hi = Kernel::apply(sHi, dHi, valpha(sHi), valpha(dHi));
+    return vpack(lo, hi);
+}
+
+template <typename Kernel, BlendFunc* scalar>
+inline void blendRowWith(const GPixel src[], GPixel dst[], int n) {
+    int i = 0;
+#if defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        vstore(dst + i, blendPixels<Kernel>(_mm256_loadu_si256((const __m256i*)(src + i)),
+                                            _mm256_loadu_si256((const __m256i*)(dst + i))));
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        vstore(dst + i, blendPixels<Kernel>(_mm_loadu_si128((const __m128i*)(src + i)),
+                                            _mm_loadu_si128((const __m128i*)(dst + i))));
+    }
+#endif
+    for (; i < n; ++i) {
+        dst[i] = scalar(src[i], dst[i]);
+    }
+}
+
+// Same as blendRowWith, but for a single src color. Returns how many pixels were blended,
+// leaving the (short) tail to the caller.
+template <typename Kernel>
+inline int blendColorVector(GPixel src, GPixel dst[], int n) {
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i src8 = _mm256_set1_epi32(src);
+    for (; i + 8 <= n; i += 8) {
+        vstore(dst + i, blendPixels<Kernel>(src8, _mm256_loadu_si256((const __m256i*)(dst + i))));
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i src4 = _mm_set1_epi32(src);
+    for (; i + 4 <= n; i += 4) {
+        vstore(dst + i, blendPixels<Kernel>(src4, _mm_loadu_si128((const __m128i*)(dst + i))));
+    }
+#endif
+    return i;
+}
+
+template <typename Kernel, BlendFunc* scalar>
+inline void blendColorWith(GPixel src, GPixel dst[], int n) {
+    for (int i = blendColorVector<Kernel>(src, dst, n); i < n; ++i) {
+        dst[i] = scalar(src, dst[i]);
+    }
+}
+
+// Blend n src pixels into dst with the given mode
+inline void blendRow(GBlendMode mode, const GPixel src[], GPixel dst[], int n) {
+    switch (mode) {
+        case GBlendMode::kClear:
+            std::fill(dst, dst + n, 0);
+            break;
+        case GBlendMode::kSrc:
+            std::copy(src, src + n, dst);
+            break;
+        case GBlendMode::kDst:
+            break;
+        case GBlendMode::kSrcOver:
+            blendRowWith<SrcOverKernel, blend_srcOver>(src, dst, n);
+            break;
+        case GBlendMode::kDstOver:
+            blendRowWith<DstOverKernel, blend_dstOver>(src, dst, n);
+            break;
+        case GBlendMode::kSrcIn:
+            blendRowWith<SrcInKernel, blend_srcIn>(src, dst, n);
+            break;
+        case GBlendMode::kDstIn:
+            blendRowWith<DstInKernel, blend_dstIn>(src, dst, n);
+            break;
+        case GBlendMode::kSrcOut:
+            blendRowWith<SrcOutKernel, blend_srcOut>(src, dst, n);
+            break;
+        case GBlendMode::kDstOut:
+            blendRowWith<DstOutKernel, blend_dstOut>(src, dst, n);
+            break;
+        case GBlendMode::kSrcATop:
+            blendRowWith<SrcATopKernel, blend_srcATop>(src, dst, n);
+            break;
+        case GBlendMode::kDstATop:
+            blendRowWith<DstATopKernel, blend_dstATop>(src, dst, n);
+            break;
+        case GBlendMode::kXor:
+            blendRowWith<XorKernel, blend_xor>(src, dst, n);
+            break;
+    }
+}
+
+// (d * (255 - c) + b * c) / 255 per component, rounded: moves d toward b by coverage c
+inline GPixel lerpPixel(GPixel d, GPixel b, unsigned c) {
+    unsigned result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        unsigned dc = (d >> shift) & 0xFF;
+        unsigned bc = (b >> shift) & 0xFF;
+        unsigned x = dc * (255 - c) + bc * c + 128;
+        result |= ((x + (x >> 8)) >> 8) << shift;
+    }
+    return result;
+}
+
+// Blends one premultiplied color into rows of pixels. Built once per draw, so the mode is
+// reduced for the color's alpha up front and srcOver gets its (1 - Sa) * D table.
+class ColorBlender {
+public:
+    ColorBlender(GBlendMode mode, GPixel src)
+        : fMode(optimize(mode, GPixel_GetA(src) / 255.0f)), fSrc(src) {
+        if (fMode == GBlendMode::kSrcOver) {
+            int invSa = 255 - GPixel_GetA(src);
+            for (int v = 0; v < 256; ++v) {
+                fScale[v] = static_cast<uint8_t>(divide255(v * invSa));
+            }
+        }
+    }
+
+    GBlendMode mode() const { return fMode; }
+
+    void blendRow(GPixel dst[], int n) const {
+        switch (fMode) {
+            case GBlendMode::kClear:
+                std::fill(dst, dst + n, 0);
+                break;
+            case GBlendMode::kSrc:
+                std::fill(dst, dst + n, fSrc);
+                break;
+            case GBlendMode::kDst:
+                break;
+            case GBlendMode::kSrcOver:
+                this->srcOverRow(dst, n);
+                break;
+            case GBlendMode::kDstOver:
+                blendColorWith<DstOverKernel, blend_dstOver>(fSrc, dst, n);
+                break;
+            case GBlendMode::kSrcIn:
+                blendColorWith<SrcInKernel, blend_srcIn>(fSrc, dst, n);
+                break;
+            case GBlendMode::kDstIn:
+                blendColorWith<DstInKernel, blend_dstIn>(fSrc, dst, n);
+                break;
+            case GBlendMode::kSrcOut:
+                blendColorWith<SrcOutKernel, blend_srcOut>(fSrc, dst, n);
+                break;
+            case GBlendMode::kDstOut:
+                blendColorWith<DstOutKernel, blend_dstOut>(fSrc, dst, n);
+                break;
+            case GBlendMode::kSrcATop:
+                blendColorWith<SrcATopKernel, blend_srcATop>(fSrc, dst, n);
+                break;
+            case GBlendMode::kDstATop:
+                blendColorWith<DstATopKernel, blend_dstATop>(fSrc, dst, n);
+                break;
+            case GBlendMode::kXor:
+                blendColorWith<XorKernel, blend_xor>(fSrc, dst, n);
+                break;
+        }
+    }
+
+private:
+    // S + (1 - Sa) * D: the vector kernel where we have one, table lookups for the rest
+    void srcOverRow(GPixel dst[], int n) const {
+        int Sa = GPixel_GetA(fSrc), Sr = GPixel_GetR(fSrc), Sg = GPixel_GetG(fSrc), Sb = GPixel_GetB(fSrc);
+        for (int i = blendColorVector<SrcOverKernel>(fSrc, dst, n); i < n; ++i) {
+            GPixel d = dst[i];
+            dst[i] = PACK_ARGB(Sa + fScale[GET_ALPHA(d)], Sr + fScale[GET_RED(d)],
+                               Sg + fScale[GET_GREEN(d)], Sb + fScale[GET_BLUE(d)]);
+        }
+    }
+
+    GBlendMode fMode;
+    GPixel     fSrc;
+    uint8_t    fScale[256];  // divide255(v * (255 - Sa)), only built for kSrcOver
+};
+
+#endif
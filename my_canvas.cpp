@@ -12,21 +12,128 @@
 #include "include/GShader.h"
 #include "include/GCanvas.h"
 #include "include/GPath.h"
-#include "ProxyShader.h"
-#include "TriColorShader.h"
-#include "CompositeShader.h"
+#include "include/GPathBuilder.h"
+#include "CopyableShader.h"
+#include "MeshShader.h"
+#include "Stroker.h"
+#include "Blitter.h"
 #include <stack>
 #include <iostream>
 #include <memory>
 #include <algorithm>
+#include <thread>
+
+// Build the device-space edges of a path, sorted by top Y and then by X. Edges are scaled by
+// superScale for supersampling; curves are flattened to 1/4 device pixel either way.
+static void buildEdges(const GPath& path, const GMatrix& ctm, std::vector<Edge>& edges,
+                       GVector superScale = {1, 1}) {
+    GPath::Edger edger(path);
+    GPoint points[4];
+    const float tolerance = 0.25f;  // Tolerance of 1/4 pixel
+    const GMatrix lineMatrix = GMatrix::Concat(GMatrix::Scale(superScale.x, superScale.y), ctm);
+
+    // Extract all edges from the path using the edger
+    while (auto verb = edger.next(points)) {
+        switch (verb.value()) {
+            case GPathVerb::kLine:
+                // Map points to canvas space and add line edge
+                lineMatrix.mapPoints(points, points, 2);
+                addEdge(edges, points[0], points[1]);
+                break;
+
+            case GPathVerb::kQuad:
+            case GPathVerb::kCubic:
+                flattenCurve(points, verb.value() + 1, edges, ctm, tolerance, superScale);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    // Sort edges by their top Y values and then by their X values
+    std::sort(edges.begin(), edges.end(), compareEdges);
+}
+
+// Walk rows [top, bottom) of sorted edges with an active edge table, calling span(y, left, right)
+// for every run of non-zero winding. Running X is re-derived on rows that are multiples of
+// kBandHeight, so any split of the rows into bands produces the same spans.
+template <typename SpanProc>
+static void scanEdges(const std::vector<Edge>& edges, int top, int bottom, SpanProc&& span) {
+    // Active edge table: a cursor into the top-sorted edges plus the edges crossing this row
+    std::vector<Edge> activeEdges;
+    size_t nextEdge = 0;
+
+    // Scanline-based rendering: Process each Y value in [top, bottom)
+    for (int y = top; y < bottom; ++y) {
+        // Remove edges that are no longer valid for this scanline
+        activeEdges.erase(std::remove_if(activeEdges.begin(), activeEdges.end(),
+            [y](const Edge& edge) { return edge.bottom <= y; }), activeEdges.end());
+
+        // Nothing active: jump straight to the next edge's first row
+        if (activeEdges.empty()) {
+            if (nextEdge == edges.size()) {
+                break;
+            }
+            y = std::max(y, edges[nextEdge].top);
+            if (y >= bottom) {
+                break;
+            }
+        }
+
+        // Re-derive the running X at band boundaries so banding never changes the result
+        if (y % MyCanvas::kBandHeight == 0) {
+            for (Edge& edge : activeEdges) {
+                edge.x = edge.computeX(y);
+            }
+        }
+
+        // Pull in the edges that start at this scanline (or above it, entering a band)
+        while (nextEdge < edges.size() && edges[nextEdge].top <= y) {
+            Edge edge = edges[nextEdge++];
+            if (edge.bottom > y) {
+                edge.x = edge.computeX(y);
+                activeEdges.push_back(edge);
+            }
+        }
+
+        sortActiveEdges(activeEdges);
+
+        int winding = 0;
+        int leftX = 0;
+ 
+        // Process the active edges for this scanline
+        for (Edge& edge : activeEdges) {
+            int x = GRoundToInt(edge.x);
+
+            if (winding == 0) {
+                leftX = x;  // Start a new span
+            }
+
+            winding += edge.winding;  // Update the winding value
+
+            if (winding == 0) {
+                // End of a filled span (when winding becomes zero)
+                int rightX = x;
+                if (rightX > leftX) {  // Ensure we're drawing in the correct order
+                    span(y, leftX, rightX);
+                }
+            }
+
+            edge.x += edge.slope;  // Step to the next scanline
+        }
+    }
+}
 
 void MyCanvas::save() {
     fMatrixStack.push(fMatrixStack.top());  // Save current CTM
+    fClipStack.push(fClipStack.top());      // and clip (masks are shared, not copied)
 }
 
 void MyCanvas::restore() {
     if (fMatrixStack.size() > 1) {
         fMatrixStack.pop();  // Restore previous CTM
+        fClipStack.pop();
     }
 }
 
@@ -34,6 +141,65 @@ void MyCanvas::concat(const GMatrix& matrix) {
     fMatrixStack.top() = GMatrix::Concat(fMatrixStack.top(), matrix);
 }
 
+void MyCanvas::clipRect(const GRect& rect) {
+    const GMatrix& ctm = fMatrixStack.top();
+    if (ctm[1] != 0 || ctm[2] != 0) {
+        // A rotated rect is no longer a rect in device space
+        GPoint pts[4] = {
+            {rect.left, rect.top},
+            {rect.right, rect.top},
+            {rect.right, rect.bottom},
+            {rect.left, rect.bottom},
+        };
+        GPathBuilder builder;
+        builder.addPolygon(pts, 4);
+        this->clipPath(*builder.detach());
+        return;
+    }
+
+    // Axis-aligned: the rows and columns a fill would touch become the new bounds
+    Clip& clip = fClipStack.top();
+    clip.bounds = intersectBounds(clip.bounds, mapBounds(ctm, rect));
+}
+
+void MyCanvas::clipPath(const GPath& path) {
+    Clip& clip = fClipStack.top();
+    const GMatrix& ctm = fMatrixStack.top();
+    GIRect bounds = intersectBounds(clip.bounds, mapBounds(ctm, path.bounds()));
+
+    std::vector<Edge> edges;
+    buildEdges(path, ctm, edges);
+    if (bounds.isEmpty() || edges.empty()) {
+        clip = {GIRect::LTRB(0, 0, 0, 0), nullptr};
+        return;
+    }
+
+    // Scan the path into a mask over the new bounds, then intersect with any previous mask
+    auto mask = std::make_shared<ClipMask>();
+    mask->bounds = bounds;
+    mask->coverage.assign(static_cast<size_t>(bounds.width()) * bounds.height(), 0);
+    scanEdges(edges, bounds.top, bounds.bottom, [&](int y, int left, int right) {
+        left = std::max(left, bounds.left);
+        right = std::min(right, bounds.right);
+        if (left < right) {
+            uint8_t* row = mask->row(y) - bounds.left;
+            std::fill(row + left, row + right, 0xFF);
+        }
+    });
+
+    if (clip.mask) {
+        for (int y = bounds.top; y < bounds.bottom; ++y) {
+            uint8_t* row = mask->row(y);
+            const uint8_t* prev = clip.mask->row(y) + (bounds.left - clip.mask->bounds.left);
+            for (int x = 0; x < bounds.width(); ++x) {
+                row[x] &= prev[x];
+            }
+        }
+    }
+
+    clip = {bounds, std::move(mask)};
+}
+
 void MyCanvas::clear(const GColor& color) {
     // Convert GColor to GPixel (with our helper func)
     GPixel pixel = ColorToPixel(color);
@@ -129,6 +295,26 @@ void MyCanvas::drawRect(const GRect& rect, const GPaint& paint) {
         {rect.left, rect.bottom},
     };
 
+    // A scale/translate CTM keeps the rect axis-aligned, so it can be blitted row by row
+    // (anti-aliased rects may have fractional edges, so they take the polygon path)
+    const GMatrix& ctm = fMatrixStack.top();
+    if (ctm[1] == 0 && ctm[2] == 0 && !paint.isAntiAlias()) {
+        GRect deviceBounds = mapBounds(ctm, rect);
+        if (this->quickReject(deviceBounds)) {
+            return;
+        }
+        Blitter blitter(fDevice, fClipStack.top(), paint, ctm, fRowBuffer.data());
+        if (blitter.isNoop()) {
+            return;
+        }
+        GIRect bounds = intersectBounds(fClipStack.top().bounds, deviceBounds);
+        this->forEachBand(bounds.top, bounds.bottom, blitter,
+                          [&](int top, int bottom, int, Blitter& bandBlitter) {
+            bandBlitter.blitRect(bounds.left, top, bounds.right, bottom);
+        });
+        return;
+    }
+
     // Call drawConvexPolygon using these points
     this->drawConvexPolygon(pts, 4, paint);
 
@@ -178,150 +364,114 @@ void MyCanvas::drawRect(const GRect& rect, const GPaint& paint) {
 
 
 void MyCanvas::drawConvexPolygon(const GPoint points[], int count, const GPaint& paint) {
-    GBlendMode blendMode = paint.getBlendMode();
-
-    if (paint.peekShader() == NULL) {
-        blendMode = optimize(blendMode, paint.getAlpha());
-    }
-
-    // Early exit if blend mode results in no changes
-    if (blendMode == GBlendMode::kDst) {
-        return;  // No need to draw
+    if (count < 3) {
+        return;
     }
 
-    int width = fDevice.width();
-    int height = fDevice.height();
-
     // Transform the polygon points by the current transformation matrix (CTM)
     GPoint transformedPoints[count];
     fMatrixStack.top().mapPoints(transformedPoints, points, count);
 
-    // Compute the bounds after transformation
-    GRect bounds = computeBounds(transformedPoints, count);
+    // Cull before the shader is placed
+    if (this->quickReject(computeBounds(transformedPoints, count))) {
+        return;
+    }
 
-    // Ensure the polygon is within the bounds of the canvas
-    int top = std::max(0, static_cast<int>(bounds.top));
-    int bottom = std::min(height, static_cast<int>(bounds.bottom));
+    if (paint.isAntiAlias()) {
+        GPathBuilder builder;
+        builder.addPolygon(points, count);
+        this->drawPathAA(*builder.detach(), paint);
+        return;
+    }
 
-    // Sort edges for scanline rasterization
-    std::vector<Edge> edges;
-    for (int i = 0; i < count; ++i) {
-        int j = (i + 1) % count;    // Wrap around to create a closed polygon
-        addEdge(edges, transformedPoints[i], transformedPoints[j]);
+    // The blitter reduces the blend mode and reports when nothing would change
+    Blitter blitter(fDevice, fClipStack.top(), paint, fMatrixStack.top(), fRowBuffer.data());
+    if (blitter.isNoop()) {
+        return;
     }
-    std::sort(edges.begin(), edges.end(), compareEdges);
 
-    // Rasterize the polygon using blit
-    for (int y = top; y < bottom; ++y) {
-        std::vector<int> intersections;
+    this->scanConvex(transformedPoints, count, blitter);
+}
 
-        // Calculate intersections of edges with the current scanline
-        for (const auto& edge : edges) {
-            if (edge.top <= y && edge.bottom > y) {
-                float x = edge.computeX(y);
-                intersections.push_back(static_cast<int>(std::round(x)));
-            }
-        }
+// Shared convex scan converter (drawRect, drawConvexPolygon and drawMesh all end up here).
+// Exactly two edges cross each row of a convex polygon, so we walk a left and a right chain
+// down from the top vertex rather than intersecting and sorting every edge per row.
+void MyCanvas::scanConvex(const GPoint pts[], int count, Blitter& blitter) {
+    if (count < 3) {
+        return;
+    }
 
-        // Sort intersections to determine the active spans to fill
-        if (intersections.size() >= 2) {
-            std::sort(intersections.begin(), intersections.end());
-            int left = std::max(0, intersections.front());
-            int right = std::min(width, intersections.back());
+    const GIRect& clip = fClipStack.top().bounds;
 
-            // Use the blit function for shading between the intersections
-            blit(left, y, right - left, paint, fDevice, fMatrixStack.top());  // Shade the span using blit
+    // Find the top vertex and the lowest Y; rows are clipped to the clip bounds
+    int topIndex = 0;
+    float maxY = pts[0].y;
+    for (int i = 1; i < count; ++i) {
+        if (pts[i].y < pts[topIndex].y) {
+            topIndex = i;
         }
+        maxY = std::max(maxY, pts[i].y);
     }
+    int top = std::max(clip.top, GRoundToInt(pts[topIndex].y));
+    int bottom = std::min(clip.bottom, GRoundToInt(maxY));
+
+    this->forEachBand(top, bottom, blitter, [&](int bandTop, int bandBottom, int, Blitter& bandBlitter) {
+        this->scanConvexRows(pts, count, bandTop, bandBottom, bandBlitter);
+    });
 }
 
-// Handle winding-based non-convex polygons
-void MyCanvas::drawPath(const GPath& path, const GPaint& paint) {
-    std::vector<Edge> edges;
-    GPath::Edger edger(path);
-    GPoint points[4];
-    const float tolerance = 0.25f;  // Tolerance of 1/4 pixel
+void MyCanvas::scanConvexRows(const GPoint pts[], int count, int top, int bottom,
+                              Blitter& blitter) {
+    const GIRect& clip = fClipStack.top().bounds;
 
-    /* // Check if the paint uses a StrokeShader
-    auto shader = dynamic_cast<StrokeShader*>(paint.peekShader());
-    if (shader) {
-        // Collect all points and flatten curves from the path
-        std::vector<GPoint> originalPoints;
-
-        while (auto verb = edger.next(points)) {
-            switch (verb.value()) {
-                case GPathVerb::kLine: {
-                    // Map points to canvas space and add to originalPoints
-                    fMatrixStack.top().mapPoints(points, points, 2);
-                    originalPoints.push_back(points[0]);
-                    originalPoints.push_back(points[1]);
-                    break;
-                }
-                case GPathVerb::kQuad: {
-                    // Flatten the quadratic curve into line segments
-                    std::vector<Edge> tempEdges;
-                    flattenQuad(points, tempEdges, fMatrixStack.top(), tolerance);
-
-                    for (const auto& edge : tempEdges) {
-                        originalPoints.push_back({edge.computeX(edge.top), (float)edge.top});
-                        originalPoints.push_back({edge.computeX(edge.bottom), (float)edge.bottom});
-                    }
-                    break;
-                }
-                case GPathVerb::kCubic: {
-                    // Flatten the cubic curve into line segments
-                    std::vector<Edge> tempEdges;
-                    flattenCubic(points, tempEdges, fMatrixStack.top(), tolerance);
-
-                    for (const auto& edge : tempEdges) {
-                        originalPoints.push_back({edge.computeX(edge.top), (float)edge.top});
-                        originalPoints.push_back({edge.computeX(edge.bottom), (float)edge.bottom});
-                    }
-                    break;
-                }
-                default:
-                    break;
-            }
+    int topIndex = 0;
+    for (int i = 1; i < count; ++i) {
+        if (pts[i].y < pts[topIndex].y) {
+            topIndex = i;
         }
+    }
+    ConvexChain chainA(pts, count, topIndex, +1);
+    ConvexChain chainB(pts, count, topIndex, -1);
 
-        // Generate the stroked polygon using the shader
-        std::vector<GPoint> strokedPoints;
-        shader->generateStrokedPolygon(originalPoints.data(), originalPoints.size(), strokedPoints);
-
-        // Draw the stroked polygon as a convex polygon
-        this->drawConvexPolygon(strokedPoints.data(), strokedPoints.size(), paint);
-        return;
-    }*/
+    for (int y = top; y < bottom; ++y) {
+        if (!chainA.seek(y) || !chainB.seek(y)) {
+            break;
+        }
 
-    // Extract all edges from the path using the edger
-    while (auto verb = edger.next(points)) {
-        switch (verb.value()) {
-            case GPathVerb::kLine:
-                // Map points to canvas space and add line edge
-                fMatrixStack.top().mapPoints(points, points, 2);
-                addEdge(edges, points[0], points[1]);
-                break;
+        float xA = chainA.computeX(y);
+        float xB = chainB.computeX(y);
+        int left = GRoundToInt(std::min(xA, xB));
+        int right = GRoundToInt(std::max(xA, xB));
+        left = std::max(clip.left, left);
+        right = std::min(clip.right, right);
 
-            case GPathVerb::kQuad:
-                // Recursively flatten the quadratic curve into line segments
-                flattenQuad(points, edges, fMatrixStack.top(), tolerance);
-                break;
+        // Shade the span between the two edges
+        blitter.blitRow(left, y, right - left);
+    }
+}
 
-            case GPathVerb::kCubic:
-                // Recursively flatten the cubic curve into line segments
-                flattenCubic(points, edges, fMatrixStack.top(), tolerance);
-                break;
+// Handle winding-based non-convex polygons
+void MyCanvas::drawPath(const GPath& path, const GPaint& paint) {
+    // Skip flattening and edge building for paths that land entirely off the device
+    if (this->quickReject(mapBounds(fMatrixStack.top(), path.bounds()))) {
+        return;
+    }
 
-            default:
-                break;
-        }
+    if (paint.isAntiAlias()) {
+        this->drawPathAA(path, paint);
+        return;
     }
 
-    // Sort edges by their top Y values and then by their X values
-    std::sort(edges.begin(), edges.end(), compareEdges);
+    std::vector<Edge> edges;
+    buildEdges(path, fMatrixStack.top(), edges);
 
     if (edges.empty()) return; // Avoid out-of-bounds access
 
+    Blitter blitter(fDevice, fClipStack.top(), paint, fMatrixStack.top(), fRowBuffer.data());
+    if (blitter.isNoop()) {
+        return;
+    }
+
     int yMin = edges[0].top;
     int yMax = edges[0].bottom;
 
@@ -330,136 +480,451 @@ void MyCanvas::drawPath(const GPath& path, const GPaint& paint) {
         yMax = std::max(yMax, edge.bottom);
     }
 
-    // Active edge list for edges at each scanline
-    std::vector<Edge> activeEdges;
+    int top = std::max(yMin, fClipStack.top().bounds.top);
+    int bottom = std::min(yMax, fClipStack.top().bounds.bottom);
 
-    // Scanline-based rendering: Process each Y value from yMin to yMax
-    for (int y = yMin; y < yMax; ++y) {
-        // Remove edges that are no longer valid for the next scanline
-        activeEdges.erase(std::remove_if(activeEdges.begin(), activeEdges.end(),
-            [y](const Edge& edge) { return !edge.isValid(y); }), activeEdges.end());
+    this->forEachBand(top, bottom, blitter, [&](int bandTop, int bandBottom, int, Blitter& bandBlitter) {
+        scanEdges(edges, bandTop, bandBottom, [&](int y, int left, int right) {
+            bandBlitter.blitRow(left, y, right - left);
+        });
+    });
+}
 
-        // Add new edges that are active at this scanline
-        for (const auto& edge : edges) {
-            if (edge.top == y) {
-                activeEdges.push_back(edge);
+// Supersampled coverage: edges are built kSuperX x kSuperY times larger than the device, each
+// device row sums kSuperY sub-scanlines, and every span adds its exact overlap (in 1/kSuperX
+// pixels) with the pixels it crosses. Only the pixels where coverage changes are recorded, so a
+// row costs O(edges), and it is blitted as runs of uniform coverage; interior runs are fully
+// covered and blit at the aliased speed.
+void MyCanvas::drawPathAA(const GPath& path, const GPaint& paint) {
+    constexpr int kSuperX = 16;
+    constexpr int kSuperY = 4;
+    constexpr int kFullCoverage = kSuperX * kSuperY;
+
+    const GMatrix& ctm = fMatrixStack.top();
+    std::vector<Edge> edges;
+    buildEdges(path, ctm, edges, {kSuperX, kSuperY});
+    if (edges.empty()) {
+        return;
+    }
+
+    Blitter blitter(fDevice, fClipStack.top(), paint, ctm, fRowBuffer.data());
+    if (blitter.isNoop()) {
+        return;
+    }
+
+    int yMax = edges[0].bottom;
+    for (const auto& edge : edges) {
+        yMax = std::max(yMax, edge.bottom);
+    }
+
+    const GIRect clip = fClipStack.top().bounds;
+    int top = std::max(clip.top, edges[0].top / kSuperY);
+    int bottom = std::min(clip.bottom, (yMax + kSuperY - 1) / kSuperY);
+
+    this->forEachBand(top, bottom, blitter, [&](int bandTop, int bandBottom, int, Blitter& bandBlitter) {
+        // Per pixel (from clip.left; one extra slot for spans ending on clip.right): coverage
+        // of that pixel alone, and the change in coverage shared by every pixel from there on
+        std::vector<int> partial(clip.width() + 1);
+        std::vector<int> delta(clip.width() + 1);
+        std::vector<int> touched;
+        int row = bandTop;
+
+        // Adjacent pixels with the same coverage go to the blitter as one run
+        int runX = 0, runCount = 0, runCoverage = 0;
+        auto emit = [&](int x, int count, int sum) {
+            if (count <= 0) {
+                return;
             }
-        }
+            int coverage = (sum * 255 + kFullCoverage / 2) / kFullCoverage;
+            if (coverage == runCoverage && x == runX + runCount) {
+                runCount += count;
+                return;
+            }
+            bandBlitter.blitAntiRun(clip.left + runX, row, runCount, static_cast<uint8_t>(runCoverage));
+            runX = x;
+            runCount = count;
+            runCoverage = coverage;
+        };
 
-        // Sort active edges by their current X values
-        std::sort(activeEdges.begin(), activeEdges.end(), [&y](const Edge& a, const Edge& b) {
-            return a.computeX(y) < b.computeX(y);
-        });
+        auto flushRow = [&]() {
+            std::sort(touched.begin(), touched.end());
+            touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+            int running = 0;
+            for (size_t i = 0; i < touched.size(); ++i) {
+                int x = touched[i];
+                running += delta[x];
+                emit(x, 1, partial[x] + running);
+                int next = i + 1 < touched.size() ? touched[i + 1] : x + 1;
+                emit(x + 1, next - x - 1, running);
+                partial[x] = delta[x] = 0;
+            }
+            emit(0, 1, 0);  // Flushes the last run
+            touched.clear();
+            runCount = 0;
+        };
 
-        int winding = 0;
-        int leftX = 0;
- 
-        // Process the active edges for this scanline
-        for (size_t i = 0; i < activeEdges.size(); ++i) {
-            const Edge& edge = activeEdges[i];
-            int x = GRoundToInt(edge.computeX(y));
+        scanEdges(edges, bandTop * kSuperY, bandBottom * kSuperY, [&](int superY, int left, int right) {
+            if (superY / kSuperY != row) {
+                flushRow();
+                row = superY / kSuperY;
+            }
 
-            if (winding == 0) {
-                leftX = x;  // Start a new span
+            left = std::max(left, clip.left * kSuperX) - clip.left * kSuperX;
+            right = std::min(right, clip.right * kSuperX) - clip.left * kSuperX;
+            if (left >= right) {
+                return;
             }
 
-            winding += edge.winding;  // Update the winding value
+            int x0 = left / kSuperX;
+            int x1 = right / kSuperX;
+            if (x0 == x1) {
+                partial[x0] += right - left;
+                touched.push_back(x0);
+            } else {
+                partial[x0] += kSuperX - left % kSuperX;
+                delta[x0 + 1] += kSuperX;
+                delta[x1] -= kSuperX;
+                partial[x1] += right % kSuperX;
+                touched.insert(touched.end(), {x0, x0 + 1, x1});
+            }
+        });
+        flushRow();
+    });
+}
 
-            if (winding == 0) {
-                // End of a filled span (when winding becomes zero)
-                int rightX = x;
-                if (rightX > leftX) {  // Ensure we're drawing in the correct order
-                    blit(leftX, y, rightX - leftX, paint, fDevice, fMatrixStack.top());
-                }
+// One-pixel line from p0 to p1 in device space. Steps one pixel at a time along the major axis,
+// drawing the columns (or rows) whose centers fall in [start, end) so joined segments don't
+// both draw the shared end, and carries the minor coordinate in 16.16 fixed point. Aliased lines
+// draw the pixel under the line, merging horizontal runs; antialiased ones split each step
+// between the two nearest pixels (Wu).
+static void hairLine(GPoint p0, GPoint p1, const GIRect& clip, bool antiAlias, Blitter& blitter) {
+    bool xMajor = std::abs(p1.x - p0.x) >= std::abs(p1.y - p0.y);
+    // u is the major axis, v the minor
+    float u0 = xMajor ? p0.x : p0.y, v0 = xMajor ? p0.y : p0.x;
+    float u1 = xMajor ? p1.x : p1.y, v1 = xMajor ? p1.y : p1.x;
+    if (u0 > u1) {
+        std::swap(u0, u1);
+        std::swap(v0, v1);
+    }
+    if (!(u1 - u0 > 0)) {
+        return;
+    }
+    float slope = (v1 - v0) / (u1 - u0);
+
+    // Only step over the part of the line that can reach the clip, padded a pixel for Wu
+    float uMin = static_cast<float>(xMajor ? clip.left : clip.top) - 1;
+    float uMax = static_cast<float>(xMajor ? clip.right : clip.bottom) + 1;
+    float vMin = static_cast<float>(xMajor ? clip.top : clip.left) - 1;
+    float vMax = static_cast<float>(xMajor ? clip.bottom : clip.right) + 1;
+    float start = std::max(u0, uMin), end = std::min(u1, uMax);
+    if (slope != 0) {
+        float uAtMin = u0 + (vMin - v0) / slope, uAtMax = u0 + (vMax - v0) / slope;
+        start = std::max(start, std::min(uAtMin, uAtMax));
+        end = std::min(end, std::max(uAtMin, uAtMax));
+    } else if (v0 < vMin || v0 > vMax) {
+        return;
+    }
+    if (!(start < end)) {
+        return;
+    }
+
+    // v starts from the line's own first pixel (or a fixed point far off the device) and steps
+    // from there, so trimming the line to a different clip (e.g. a band) doesn't move the
+    // pixels it keeps
+    if (!std::isfinite(u0) || !std::isfinite(v0) || !std::isfinite(slope)) {
+        return;
+    }
+    int lineFirst = GCeilToInt(std::max(u0, -4194304.0f) - 0.5f);
+    int first = GCeilToInt(start - 0.5f);
+    int last = GCeilToInt(end - 0.5f);  // Exclusive
+    int64_t step = static_cast<int64_t>(std::llround(slope * 65536));
+    int64_t v = static_cast<int64_t>(std::llround((v0 + (lineFirst + 0.5f - u0) * slope) * 65536)) +
+                static_cast<int64_t>(first - lineFirst) * step;
+
+    auto plot = [&](int u, int minor, uint8_t coverage) {
+        if (xMajor) {
+            blitter.blitAntiRun(u, minor, 1, coverage);
+        } else {
+            blitter.blitAntiRun(minor, u, 1, coverage);
+        }
+    };
+
+    if (antiAlias) {
+        for (int u = first; u < last; ++u, v += step) {
+            int64_t centered = v - 32768;  // Distance past the center of the pixel above
+            int minor = static_cast<int>(centered >> 16);
+            int fraction = static_cast<int>((centered >> 8) & 0xFF);
+            plot(u, minor, static_cast<uint8_t>(255 - fraction));
+            plot(u, minor + 1, static_cast<uint8_t>(fraction));
+        }
+    } else if (xMajor) {
+        int runX = first, runY = static_cast<int>(v >> 16);
+        for (int x = first; x < last; ++x, v += step) {
+            int y = static_cast<int>(v >> 16);
+            if (y != runY) {
+                blitter.blitRow(runX, runY, x - runX);
+                runX = x;
+                runY = y;
             }
         }
+        blitter.blitRow(runX, runY, last - runX);
+    } else {
+        for (int y = first; y < last; ++y, v += step) {
+            blitter.blitRow(static_cast<int>(v >> 16), y, 1);
+        }
+    }
+}
+
+void MyCanvas::drawStroke(const GPath& path, float width, GStrokeJoin join, GStrokeCap cap,
+                          const GPaint& paint) {
+    if (this->isHairline(width)) {
+        this->drawHairline(path, paint);
+    } else {
+        Stroker::DrawOutline(this, path, width, join, cap, paint);
+    }
+}
+
+bool MyCanvas::isHairline(float width) const {
+    // The largest factor the matrix stretches any direction by (its larger singular value)
+    const GMatrix& m = fMatrixStack.top();
+    float sum = m[0] * m[0] + m[1] * m[1] + m[2] * m[2] + m[3] * m[3];
+    float det = m[0] * m[3] - m[1] * m[2];
+    float maxScale = std::sqrt((sum + std::sqrt(std::max(sum * sum - 4 * det * det, 0.0f))) / 2);
+    return width * maxScale <= 1;
+}
+
+// Hairlines are cheap to step, so they are drawn on the calling thread, skipping the bands
+void MyCanvas::drawHairline(const GPath& path, const GPaint& paint) {
+    const GMatrix& ctm = fMatrixStack.top();
+    GRect bounds = mapBounds(ctm, path.bounds());
+    if (this->quickReject({bounds.left - 1, bounds.top - 1, bounds.right + 1, bounds.bottom + 1})) {
+        return;
+    }
+
+    Blitter blitter(fDevice, fClipStack.top(), paint, ctm, fRowBuffer.data());
+    if (blitter.isNoop()) {
+        return;
     }
 
+    const GIRect& clip = fClipStack.top().bounds;
+    const float tolerance = 0.25f;  // Tolerance of 1/4 pixel
+    std::vector<GPoint> polyline;
+    GPoint pts[GPath::kMaxNextPoints];
+    GPath::Iter iter(path);
+    while (auto verb = iter.next(pts)) {
+        int count = verb.value() + 1;
+        if (verb.value() == kMove) {
+            continue;
+        }
+        ctm.mapPoints(pts, pts, count);
+        polyline.assign(1, pts[0]);
+        if (verb.value() == kLine) {
+            polyline.push_back(pts[1]);
+        } else {
+            forEachCurvePoint(pts, count, curveSegmentCount(pts, count, tolerance),
+                              [&](GPoint p) { polyline.push_back(p); });
+        }
+        for (size_t i = 1; i < polyline.size(); ++i) {
+            hairLine(polyline[i - 1], polyline[i], clip, paint.isAntiAlias(), blitter);
+        }
+    }
 }
 
 void MyCanvas::drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[], int count, const int indices[], const GPaint& paint) {
     GShader* shader = paint.peekShader();
-    bool hasShader = shader != nullptr;
     bool hasColors = colors != nullptr;
-    bool hasTexs = texs != nullptr && hasShader;
+    bool hasTexs = texs != nullptr && shader != nullptr;
 
     // If there are neither colors nor textures, nothing can be drawn
-    if (!hasColors && !hasTexs) {
+    if (count <= 0 || (!hasColors && !hasTexs)) {
         return;
     }
 
+    const GMatrix& ctm = fMatrixStack.top();
+    const GIRect& clip = fClipStack.top().bounds;
+
+    // Map and cull every triangle up front, keeping the rows it covers
+    fMeshTriangles.resize(count);
+    int meshTop = clip.bottom;
+    int meshBottom = clip.top;
     for (int i = 0; i < count; ++i) {
-        // Extract triangle vertices
-        GPoint p0 = verts[indices[i * 3 + 0]];
-        GPoint p1 = verts[indices[i * 3 + 1]];
-        GPoint p2 = verts[indices[i * 3 + 2]];
-
-        // Extract associated colors
-        GColor c0 = hasColors ? colors[indices[i * 3 + 0]] : GColor::RGBA(0, 0, 0, 0);
-        GColor c1 = hasColors ? colors[indices[i * 3 + 1]] : GColor::RGBA(0, 0, 0, 0);
-        GColor c2 = hasColors ? colors[indices[i * 3 + 2]] : GColor::RGBA(0, 0, 0, 0);
-
-        // Prepare texture coordinates
-        GPoint tex[3] = {
-            hasTexs ? texs[indices[i * 3 + 0]] : GPoint{0, 0},
-            hasTexs ? texs[indices[i * 3 + 1]] : GPoint{0, 0},
-            hasTexs ? texs[indices[i * 3 + 2]] : GPoint{0, 0}
-        };
+        const int* tri = indices + i * 3;
+        GPoint pts[3] = {verts[tri[0]], verts[tri[1]], verts[tri[2]]};
+        MeshTriangle& triangle = fMeshTriangles[i];
+        ctm.mapPoints(triangle.pts, pts, 3);
+        triangle.top = triangle.bottom = 0;
+        if (this->quickReject(computeBounds(triangle.pts, 3))) {
+            continue;
+        }
+        float minY = std::min({triangle.pts[0].y, triangle.pts[1].y, triangle.pts[2].y});
+        float maxY = std::max({triangle.pts[0].y, triangle.pts[1].y, triangle.pts[2].y});
+        triangle.top = std::max(clip.top, GRoundToInt(minY));
+        triangle.bottom = std::min(clip.bottom, GRoundToInt(maxY));
+        if (triangle.top < triangle.bottom) {
+            meshTop = std::min(meshTop, triangle.top);
+            meshBottom = std::max(meshBottom, triangle.bottom);
+        }
+    }
+    if (meshTop >= meshBottom) {
+        return;
+    }
 
-        // Determine the paint to use
-        GPaint finalPaint = paint;
-
-        if (hasColors && hasTexs) {
-            // Compute the texture-to-canvas transformation
-            GMatrix texToCanvas = calculateTextureTransform(tex[0], tex[1], tex[2], p0, p1, p2);
-            auto proxyShader = std::make_shared<ProxyShader>(shader, texToCanvas);
-
-            // Create the TriColorShader
-            GPoint pts[] = {p0, p1, p2};
-            GColor cols[] = {c0, c1, c2};
-            auto triColorShader = std::make_shared<TriColorShader>(pts, cols);
-
-            // Create a composite shader
-            auto compositeShader = std::make_shared<CompositeShader>(triColorShader, proxyShader);
-            finalPaint = GPaint(compositeShader);
-        } else if (hasTexs) {
-            // Only texture shader
-            GMatrix texToCanvas = calculateTextureTransform(tex[0], tex[1], tex[2], p0, p1, p2);
-            auto proxyShader = std::make_shared<ProxyShader>(shader, texToCanvas);
-            finalPaint = GPaint(proxyShader);
-        } else if (hasColors) {
-            // Only color shader
-            GPoint pts[] = {p0, p1, p2};
-            GColor cols[] = {c0, c1, c2};
-            auto triColorShader = std::make_shared<TriColorShader>(pts, cols);
-            finalPaint = GPaint(triColorShader);
+    // Bin the triangles by the bands they touch (a counting sort, so each bin keeps mesh order)
+    int firstBin = meshTop / kBandHeight;
+    int binCount = (meshBottom - 1) / kBandHeight - firstBin + 1;
+    fMeshBinStart.assign(binCount + 1, 0);
+    for (const MeshTriangle& triangle : fMeshTriangles) {
+        if (triangle.top < triangle.bottom) {
+            for (int bin = triangle.top / kBandHeight; bin * kBandHeight < triangle.bottom; ++bin) {
+                fMeshBinStart[bin - firstBin] += 1;
+            }
         }
+    }
+    for (int bin = 1; bin <= binCount; ++bin) {
+        fMeshBinStart[bin] += fMeshBinStart[bin - 1];  // Now the end of each bin
+    }
+    fMeshBins.resize(fMeshBinStart[binCount]);
+    for (int i = count - 1; i >= 0; --i) {
+        // Filling back to front leaves each bin in mesh order and fMeshBinStart at its start
+        const MeshTriangle& triangle = fMeshTriangles[i];
+        if (triangle.top < triangle.bottom) {
+            for (int bin = triangle.top / kBandHeight; bin * kBandHeight < triangle.bottom; ++bin) {
+                fMeshBins[--fMeshBinStart[bin - firstBin]] = i;
+            }
+        }
+    }
 
-        // Draw the triangle
-        GPoint pts[] = {p0, p1, p2};
-        drawConvexPolygon(pts, 3, finalPaint);
+    // Each band worker re-points its own copy of the texture per triangle. A texture that can't
+    // be copied is shared instead, by running the bands one after another on this thread.
+    bool serial = hasTexs && !this->prepareWorkerTextures(shader);
+
+    // Meshes stay aliased: per-triangle coverage would leave seams along shared edges. The
+    // blitter only carries the device, clip and blend mode to the bands; each band shades with
+    // its own MeshShader, placed again for every triangle.
+    GPaint meshPaint = paint;
+    meshPaint.setAntiAlias(false);
+    meshPaint.setShader(nullptr);
+    Blitter blitter(fDevice, fClipStack.top(), meshPaint, ctm, fRowBuffer.data());
+
+    auto drawBins = [&](int bandTop, int bandBottom, int worker, Blitter& bandBlitter) {
+        int bandBin = bandTop / kBandHeight - firstBin;
+        GShader* texture = nullptr;
+        if (hasTexs) {
+            texture = worker == 0 ? shader : fWorkerTextures[worker].get();
+        }
+        MeshShader meshShader(texture, hasColors);
+        Blitter triangleBlitter(bandBlitter, &meshShader);
+
+        for (int bin = bandBin; (firstBin + bin) * kBandHeight < bandBottom; ++bin) {
+            int binTop = std::max(bandTop, (firstBin + bin) * kBandHeight);
+            int binBottom = std::min(bandBottom, (firstBin + bin + 1) * kBandHeight);
+            for (int k = fMeshBinStart[bin]; k < fMeshBinStart[bin + 1]; ++k) {
+                int i = fMeshBins[k];
+                const int* tri = indices + i * 3;
+                GPoint pts[3];
+                GColor cols[3];
+                GPoint tex[3];
+                for (int v = 0; v < 3; ++v) {
+                    pts[v] = verts[tri[v]];
+                    cols[v] = hasColors ? colors[tri[v]] : GColor::RGBA(0, 0, 0, 0);
+                    tex[v] = hasTexs ? texs[tri[v]] : GPoint{0, 0};
+                }
+                meshShader.setTriangle(pts, cols, tex);
+                triangleBlitter.placeShader(ctm);
+                if (!triangleBlitter.isNoop()) {
+                    const MeshTriangle& triangle = fMeshTriangles[i];
+                    this->scanConvexRows(triangle.pts, 3, std::max(binTop, triangle.top),
+                                         std::min(binBottom, triangle.bottom), triangleBlitter);
+                }
+            }
+        }
+    };
+
+    // One dispatch for the whole mesh
+    if (serial) {
+        this->MyCanvas::forEachBand(meshTop, meshBottom, blitter, drawBins);
+    } else {
+        this->forEachBand(meshTop, meshBottom, blitter, drawBins);
+    }
+}
+
+// Makes sure every band worker but the drawing thread has its own copy of texture, reusing the
+// last mesh's copies when it drew with the same texture. Returns false if it can't be copied.
+bool MyCanvas::prepareWorkerTextures(GShader* texture) {
+    int workers = this->bandWorkers();
+    if (workers == 1 || (fWorkerTextureSource.lock().get() == texture &&
+                         static_cast<int>(fWorkerTextures.size()) == workers)) {
+        return true;
     }
+
+    fWorkerTextureSource.reset();
+    fWorkerTextures.assign(workers, nullptr);
+    auto copyable = dynamic_cast<CopyableShader*>(texture);
+    for (int worker = 1; worker < workers; ++worker) {
+        fWorkerTextures[worker] = copyable ? copyable->copy() : nullptr;
+        if (!fWorkerTextures[worker]) {
+            fWorkerTextures.clear();
+            return false;
+        }
+    }
+    fWorkerTextureSource = texture->weak_from_this();
+    return true;
 }
 
 void MyCanvas::drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4], int level, const GPaint& paint) {
-    std::vector<GPoint> quadVerts;
-    std::vector<GColor> quadColors;
-    std::vector<GPoint> quadTexs;
-    std::vector<int> indices;
-
-    // Tessellate the quad
-    tessellateQuad(verts, colors, texs, level, quadVerts, quadColors, quadTexs, indices);
-    // Pass the tessellated quads as triangles to drawMesh
-    drawMesh(quadVerts.data(),
-             colors ? quadColors.data() : nullptr,
-             texs ? quadTexs.data() : nullptr,
-             indices.size() / 3,
-             indices.data(),
-             paint);
+    // Every tessellated point is a blend of the corners, so their bounds cover the whole quad
+    GPoint corners[4];
+    fMatrixStack.top().mapPoints(corners, verts, 4);
+    if (this->quickReject(computeBounds(corners, 4))) {
+        return;
+    }
+
+    // The grid for this level is cached; only the corner blends are recomputed
+    if (!fQuadTessellation.evaluate(verts, colors, texs, level)) {
+        return;
+    }
+    this->drawMesh(fQuadTessellation.verts(),
+                   colors ? fQuadTessellation.colors() : nullptr,
+                   texs ? fQuadTessellation.texs() : nullptr,
+                   fQuadTessellation.triangleCount(),
+                   fQuadTessellation.indices(),
+                   paint);
+}
+
+void MyCanvas::forEachBand(int top, int bottom, const Blitter& blitter, const BandProc& proc) {
+    if (top < bottom) {
+        Blitter bandBlitter(blitter, fRowBuffer.data());
+        proc(top, bottom, 0, bandBlitter);
+    }
+}
+
+void ParallelCanvas::forEachBand(int top, int bottom, const Blitter& blitter, const BandProc& proc) {
+    if (top >= bottom) {
+        return;
+    }
+
+    // Bands are aligned to kBandHeight in device space, clipped to [top, bottom)
+    int firstBand = top / kBandHeight;
+    int bandCount = (bottom - 1) / kBandHeight - firstBand + 1;
+
+    fPool.run(bandCount, [&](int index, int worker) {
+        int bandTop = std::max(top, (firstBand + index) * kBandHeight);
+        int bandBottom = std::min(bottom, (firstBand + index + 1) * kBandHeight);
+        Blitter bandBlitter(blitter, fRowBuffers.data() + static_cast<size_t>(worker) * fDevice.width());
+        proc(bandTop, bandBottom, worker, bandBlitter);
+    });
 }
 
 std::unique_ptr<GCanvas> GCreateCanvas(const GBitmap& device) {
     return std::unique_ptr<GCanvas>(new MyCanvas(device));
 }
 
+std::unique_ptr<GCanvas> GCreateParallelCanvas(const GBitmap& device, int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    return std::unique_ptr<GCanvas>(new ParallelCanvas(device, threadCount));
+}
+
 extern std::string GDrawSomething(GCanvas* canvas, GISize dim);
\ No newline at end of file
@@ -0,0 +1,613 @@
+/*
+ *  Copyright 2024 Shristi
+ */
+
+#include "include/GPicture.h"
+#include "include/GRect.h"
+#include "include/GShader.h"
+#include "CopyableShader.h"
+#include "Stroker.h"
+#include "ThreadPool.h"
+#include "my_utils.h"
+#include "starter_canvas.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <new>
+#include <thread>
+
+namespace {
+
+enum Op {
+    kSave_Op,
+    kRestore_Op,
+    kConcat_Op,
+    kClipRect_Op,
+    kClipPath_Op,
+    kClear_Op,
+    kDrawRect_Op,
+    kDrawConvexPolygon_Op,
+    kDrawPath_Op,
+    kDrawMesh_Op,
+    kDrawQuad_Op,
+    kDrawStroke_Op,
+};
+
+// Draws are last, so every op from kDrawRect_Op on is a draw
+bool isDraw(uint32_t op) {
+    return op >= kDrawRect_Op;
+}
+
+// Records hold only plain values; paints and paths live in the picture's side tables and are
+// referenced by index. Variable-length arrays follow their record in the command buffer.
+// Every draw record starts with bounds: the pixels it can touch, in picture coordinates.
+struct Empty {};
+
+struct Concat {
+    GMatrix matrix;
+};
+
+struct ClipRect {
+    GRect rect;
+};
+
+struct ClipPath {
+    int path;
+};
+
+struct Clear {
+    GColor color;
+};
+
+struct DrawRect {
+    GRect bounds;
+    GRect rect;
+    int paint;
+};
+
+struct DrawConvexPolygon {
+    GRect bounds;
+    int count;
+    int paint;
+    // GPoint points[count]
+};
+
+struct DrawPath {
+    GRect bounds;
+    int path;
+    int paint;
+};
+
+struct DrawMesh {
+    GRect bounds;
+    int count;
+    int vertexCount;
+    int paint;
+    bool hasColors;
+    bool hasTexs;
+    // int indices[count * 3], GPoint verts[vertexCount],
+    // GColor colors[vertexCount] (if hasColors), GPoint texs[vertexCount] (if hasTexs)
+};
+
+struct DrawQuad {
+    GRect bounds;
+    int level;
+    int paint;
+    bool hasColors;
+    bool hasTexs;
+    // GPoint verts[4], GColor colors[4] (if hasColors), GPoint texs[4] (if hasTexs)
+};
+
+struct DrawStroke {
+    GRect bounds;
+    int path;
+    int paint;
+    float width;
+    GStrokeJoin join;
+    GStrokeCap cap;
+};
+
+static_assert(offsetof(DrawRect, bounds) == 0 && offsetof(DrawConvexPolygon, bounds) == 0 &&
+              offsetof(DrawPath, bounds) == 0 && offsetof(DrawMesh, bounds) == 0 &&
+              offsetof(DrawQuad, bounds) == 0 && offsetof(DrawStroke, bounds) == 0,
+              "draw records must start with their bounds");
+
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+const GRect kEverything = GRect::LTRB(-kInfinity, -kInfinity, kInfinity, kInfinity);
+
+// Words per arena block: big enough that most pictures need only a few
+constexpr size_t kBlockWords = 4096;
+
+GRect intersect(const GRect& a, const GRect& b) {
+    return GRect::LTRB(std::max(a.left, b.left), std::max(a.top, b.top),
+                       std::min(a.right, b.right), std::min(a.bottom, b.bottom));
+}
+
+bool reaches(const GRect& bounds, const GRect& cull) {
+    return bounds.left < cull.right && bounds.top < cull.bottom &&
+           bounds.right > cull.left && bounds.bottom > cull.top;
+}
+
+template <typename T> T* copyArray(void* dst, const T src[], size_t count) {
+    memcpy(dst, src, count * sizeof(T));
+    return reinterpret_cast<T*>(static_cast<char*>(dst) + count * sizeof(T));
+}
+
+bool samePaint(const GPaint& a, const GPaint& b) {
+    return a.getColor() == b.getColor() && a.getBlendMode() == b.getBlendMode() &&
+           a.peekShader() == b.peekShader() && a.isAntiAlias() == b.isAntiAlias();
+}
+
+}  // namespace
+
+GRecordingCanvas::GRecordingCanvas() {
+    this->reset();
+}
+
+void GRecordingCanvas::reset() {
+    fPicture.reset(new GPicture);
+    fMatrices.assign(1, GMatrix());
+    fClipBounds.assign(1, kEverything);
+}
+
+// Reserve a record of type T plus trailingBytes of array data at the end of the command buffer
+template <typename T> T* GRecordingCanvas::append(int op, size_t trailingBytes) {
+    static_assert(alignof(T) <= alignof(uint32_t), "records must be word aligned");
+
+    size_t words = (sizeof(T) + trailingBytes + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+    size_t needed = 2 + words;
+    std::vector<GPicture::Block>& blocks = fPicture->fBlocks;
+    if (blocks.empty() || blocks.back().capacity - blocks.back().used < needed) {
+        size_t capacity = std::max(kBlockWords, needed);
+        blocks.push_back({std::unique_ptr<uint32_t[]>(new uint32_t[capacity]), capacity, 0});
+    }
+    GPicture::Block& block = blocks.back();
+    uint32_t* header = block.words.get() + block.used;
+    block.used += needed;
+
+    // The size gets its own word: big meshes overflow anything packed beside the op
+    assert(words <= UINT32_MAX);
+    header[0] = static_cast<uint32_t>(op);
+    header[1] = static_cast<uint32_t>(words);
+    fPicture->fCommandCount += 1;
+    return new (header + 2) T;
+}
+
+// The bounds of pts under the recorded CTM, outset by a pixel for antialiasing and limited to
+// the recorded clip. Returns false, so the draw need not be recorded, if that is empty.
+bool GRecordingCanvas::drawBounds(const GPoint pts[], int count, GRect* bounds) const {
+    const GMatrix& ctm = fMatrices.back();
+    float left = kInfinity, top = kInfinity, right = -kInfinity, bottom = -kInfinity;
+    bool finite = true;
+    for (int i = 0; i < count; ++i) {
+        GPoint p;
+        ctm.mapPoints(&p, pts + i, 1);
+        finite = finite && std::isfinite(p.x) && std::isfinite(p.y);
+        left = std::min(left, p.x);
+        top = std::min(top, p.y);
+        right = std::max(right, p.x);
+        bottom = std::max(bottom, p.y);
+    }
+    GRect r = finite ? GRect::LTRB(left - 1, top - 1, right + 1, bottom + 1) : kEverything;
+    *bounds = intersect(r, fClipBounds.back());
+    return !bounds->isEmpty();
+}
+
+// Consecutive draws usually share a paint, so only store it when it changes
+int GRecordingCanvas::recordPaint(const GPaint& paint) {
+    std::vector<GPaint>& paints = fPicture->fPaints;
+    if (paints.empty() || !samePaint(paints.back(), paint)) {
+        paints.push_back(paint);
+    }
+    return static_cast<int>(paints.size()) - 1;
+}
+
+// Paths are immutable, so one the caller already shares is kept as is; otherwise the caller
+// may free it, so keep a private copy of its points and verbs
+int GRecordingCanvas::recordPath(const GPath& path) {
+    std::shared_ptr<const GPath> shared = path.weak_from_this().lock();
+    if (!shared) {
+        std::vector<GPoint> pts;
+        std::vector<GPathVerb> verbs;
+        GPoint segment[GPath::kMaxNextPoints];
+        GPath::Iter iter(path);
+        while (auto verb = iter.next(segment)) {
+            switch (verb.value()) {
+                case kMove:  pts.push_back(segment[0]); break;
+                case kLine:  pts.insert(pts.end(), segment + 1, segment + 2); break;
+                case kQuad:  pts.insert(pts.end(), segment + 1, segment + 3); break;
+                case kCubic: pts.insert(pts.end(), segment + 1, segment + 4); break;
+            }
+            verbs.push_back(verb.value());
+        }
+        shared = std::make_shared<GPath>(std::move(pts), std::move(verbs));
+    }
+
+    std::vector<std::shared_ptr<const GPath>>& paths = fPicture->fPaths;
+    paths.push_back(std::move(shared));
+    return static_cast<int>(paths.size()) - 1;
+}
+
+void GRecordingCanvas::save() {
+    this->append<Empty>(kSave_Op);
+    fMatrices.push_back(fMatrices.back());
+    fClipBounds.push_back(fClipBounds.back());
+}
+
+void GRecordingCanvas::restore() {
+    if (fMatrices.size() == 1) {
+        return;  // Unbalanced restore; nothing to pop
+    }
+    this->append<Empty>(kRestore_Op);
+    fMatrices.pop_back();
+    fClipBounds.pop_back();
+}
+
+void GRecordingCanvas::concat(const GMatrix& matrix) {
+    this->append<Concat>(kConcat_Op)->matrix = matrix;
+    fMatrices.back() = GMatrix::Concat(fMatrices.back(), matrix);
+}
+
+void GRecordingCanvas::clipRect(const GRect& rect) {
+    this->append<ClipRect>(kClipRect_Op)->rect = rect;
+    const GPoint corners[4] = {
+        {rect.left, rect.top}, {rect.right, rect.top},
+        {rect.right, rect.bottom}, {rect.left, rect.bottom},
+    };
+    GRect bounds;
+    this->drawBounds(corners, 4, &bounds);
+    fClipBounds.back() = bounds;
+}
+
+void GRecordingCanvas::clipPath(const GPath& path) {
+    int pathIndex = this->recordPath(path);
+    this->append<ClipPath>(kClipPath_Op)->path = pathIndex;
+    GRect r = path.bounds();
+    const GPoint corners[4] = {{r.left, r.top}, {r.right, r.top}, {r.right, r.bottom}, {r.left, r.bottom}};
+    GRect bounds;
+    this->drawBounds(corners, 4, &bounds);
+    fClipBounds.back() = bounds;
+}
+
+void GRecordingCanvas::clear(const GColor& color) {
+    this->append<Clear>(kClear_Op)->color = color;
+}
+
+void GRecordingCanvas::drawRect(const GRect& rect, const GPaint& paint) {
+    const GPoint corners[4] = {
+        {rect.left, rect.top}, {rect.right, rect.top},
+        {rect.right, rect.bottom}, {rect.left, rect.bottom},
+    };
+    GRect bounds;
+    if (!this->drawBounds(corners, 4, &bounds)) {
+        return;
+    }
+    int paintIndex = this->recordPaint(paint);
+    DrawRect* rec = this->append<DrawRect>(kDrawRect_Op);
+    rec->bounds = bounds;
+    rec->rect = rect;
+    rec->paint = paintIndex;
+}
+
+void GRecordingCanvas::drawConvexPolygon(const GPoint points[], int count, const GPaint& paint) {
+    GRect bounds;
+    if (count < 3 || !this->drawBounds(points, count, &bounds)) {
+        return;
+    }
+    int paintIndex = this->recordPaint(paint);
+    DrawConvexPolygon* rec = this->append<DrawConvexPolygon>(kDrawConvexPolygon_Op,
+                                                             count * sizeof(GPoint));
+    rec->bounds = bounds;
+    rec->count = count;
+    rec->paint = paintIndex;
+    copyArray(rec + 1, points, count);
+}
+
+void GRecordingCanvas::drawPath(const GPath& path, const GPaint& paint) {
+    // A path's control points bound its curves
+    GRect r = path.bounds();
+    const GPoint corners[4] = {{r.left, r.top}, {r.right, r.top}, {r.right, r.bottom}, {r.left, r.bottom}};
+    GRect bounds;
+    if (path.countPoints() == 0 || !this->drawBounds(corners, 4, &bounds)) {
+        return;
+    }
+    int pathIndex = this->recordPath(path);
+    int paintIndex = this->recordPaint(paint);
+    DrawPath* rec = this->append<DrawPath>(kDrawPath_Op);
+    rec->bounds = bounds;
+    rec->path = pathIndex;
+    rec->paint = paintIndex;
+}
+
+void GRecordingCanvas::drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[],
+                                int count, const int indices[], const GPaint& paint) {
+    if (count <= 0) {
+        return;
+    }
+
+    // Only the vertices the indices reach are copied, and they bound the mesh
+    int vertexCount = *std::max_element(indices, indices + count * 3) + 1;
+    GRect bounds;
+    if (!this->drawBounds(verts, vertexCount, &bounds)) {
+        return;
+    }
+    bool hasTexs = texs && paint.peekShader();
+    size_t trailing = count * 3 * sizeof(int) + vertexCount * sizeof(GPoint);
+    if (colors) {
+        trailing += vertexCount * sizeof(GColor);
+    }
+    if (hasTexs) {
+        trailing += vertexCount * sizeof(GPoint);
+    }
+
+    int paintIndex = this->recordPaint(paint);
+    DrawMesh* rec = this->append<DrawMesh>(kDrawMesh_Op, trailing);
+    rec->bounds = bounds;
+    rec->count = count;
+    rec->vertexCount = vertexCount;
+    rec->paint = paintIndex;
+    rec->hasColors = colors != nullptr;
+    rec->hasTexs = hasTexs;
+
+    void* data = copyArray(rec + 1, indices, count * 3);
+    data = copyArray(data, verts, vertexCount);
+    if (colors) {
+        data = copyArray(data, colors, vertexCount);
+    }
+    if (hasTexs) {
+        copyArray(data, texs, vertexCount);
+    }
+}
+
+void GRecordingCanvas::drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4],
+                                int level, const GPaint& paint) {
+    // Every tessellated point is a blend of the corners
+    GRect bounds;
+    if (!this->drawBounds(verts, 4, &bounds)) {
+        return;
+    }
+    bool hasTexs = texs && paint.peekShader();
+    size_t trailing = 4 * sizeof(GPoint);
+    if (colors) {
+        trailing += 4 * sizeof(GColor);
+    }
+    if (hasTexs) {
+        trailing += 4 * sizeof(GPoint);
+    }
+
+    int paintIndex = this->recordPaint(paint);
+    DrawQuad* rec = this->append<DrawQuad>(kDrawQuad_Op, trailing);
+    rec->bounds = bounds;
+    rec->level = level;
+    rec->paint = paintIndex;
+    rec->hasColors = colors != nullptr;
+    rec->hasTexs = hasTexs;
+
+    void* data = copyArray(rec + 1, verts, 4);
+    if (colors) {
+        data = copyArray(data, colors, 4);
+    }
+    if (hasTexs) {
+        copyArray(data, texs, 4);
+    }
+}
+
+void GRecordingCanvas::drawStroke(const GPath& path, float width, GStrokeJoin join,
+                                  GStrokeCap cap, const GPaint& paint) {
+    // Miters reach at most twice the width past the path (a limit of 4 half widths); caps and
+    // round joins less
+    GRect r = path.bounds();
+    float outset = 2 * width;
+    const GPoint corners[4] = {
+        {r.left - outset, r.top - outset}, {r.right + outset, r.top - outset},
+        {r.right + outset, r.bottom + outset}, {r.left - outset, r.bottom + outset},
+    };
+    GRect bounds;
+    if (path.countPoints() == 0 || !this->drawBounds(corners, 4, &bounds)) {
+        return;
+    }
+    int pathIndex = this->recordPath(path);
+    int paintIndex = this->recordPaint(paint);
+    DrawStroke* rec = this->append<DrawStroke>(kDrawStroke_Op);
+    rec->bounds = bounds;
+    rec->path = pathIndex;
+    rec->paint = paintIndex;
+    rec->width = width;
+    rec->join = join;
+    rec->cap = cap;
+}
+
+std::shared_ptr<GPicture> GRecordingCanvas::finishRecording() {
+    std::shared_ptr<GPicture> picture(fPicture.release());
+    this->reset();
+    return picture;
+}
+
+void GPicture::playback(GCanvas* canvas) const {
+    this->replay(canvas, nullptr, fPaints, nullptr);
+}
+
+void GPicture::playback(GCanvas* canvas, const GRect& cull) const {
+    this->replay(canvas, &cull, fPaints, nullptr);
+}
+
+// The paints with every shader swapped for a copy another thread can place. Paints that share a
+// shader share its copy. Returns false if some shader can't be copied.
+static bool copyPaints(const std::vector<GPaint>& paints, std::vector<GPaint>* copies) {
+    std::map<GShader*, std::shared_ptr<GShader>> shaders;
+    *copies = paints;
+    for (GPaint& paint : *copies) {
+        GShader* shader = paint.peekShader();
+        if (!shader) {
+            continue;
+        }
+        std::shared_ptr<GShader>& copy = shaders[shader];
+        if (!copy) {
+            auto copyable = dynamic_cast<CopyableShader*>(shader);
+            copy = copyable ? copyable->copy() : nullptr;
+            if (!copy) {
+                return false;
+            }
+        }
+        paint.setShader(copy);
+    }
+    return true;
+}
+
+void GPicture::playbackInBands(const GBitmap& bitmap, int threadCount) const {
+    if (threadCount <= 0) {
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    // Bands start on multiples of kBandHeight, where the rasterizers restart their stepping,
+    // so clipping a draw to a band leaves its pixels in that band unchanged. A few bands per
+    // thread keep the threads busy when the draws are bunched up.
+    int height = bitmap.height();
+    int bandRows = MyCanvas::kBandHeight;
+    int rowsPerThread = (height + 4 * threadCount - 1) / (4 * threadCount);
+    bandRows *= std::max(1, (rowsPerThread + bandRows - 1) / bandRows);
+    int bandCount = (height + bandRows - 1) / bandRows;
+    if (bandCount == 0) {
+        return;
+    }
+
+    // Shaders are placed per draw, so every thread but this one draws with copies of them
+    ThreadPool pool(std::min(threadCount, bandCount));
+    std::vector<std::vector<GPaint>> threadPaints(pool.threadCount());
+    bool copied = true;
+    for (int worker = 1; worker < pool.threadCount() && copied; ++worker) {
+        copied = copyPaints(fPaints, &threadPaints[worker]);
+    }
+
+    auto drawBand = [&](int index, int worker) {
+        GRect rows = GRect::LTRB(0, static_cast<float>(index * bandRows), bitmap.width(),
+                                 static_cast<float>(std::min(height, (index + 1) * bandRows)));
+        std::unique_ptr<GCanvas> canvas = GCreateCanvas(bitmap);
+        canvas->clipRect(rows);
+        this->replay(canvas.get(), &rows, worker == 0 ? fPaints : threadPaints[worker], &bitmap);
+    };
+    if (copied) {
+        pool.run(bandCount, drawBand);
+    } else {
+        for (int index = 0; index < bandCount; ++index) {
+            drawBand(index, 0);
+        }
+    }
+}
+
+void GPicture::replay(GCanvas* canvas, const GRect* cull, const std::vector<GPaint>& paints,
+                      const GBitmap* band) const {
+    canvas->save();
+    int saveCount = 0;
+
+    for (const Block& block : fBlocks) {
+        const uint32_t* op = block.words.get();
+        const uint32_t* stop = op + block.used;
+        while (op < stop) {
+            uint32_t type = *op++;
+            uint32_t words = *op++;
+            const void* rec = op;
+            op += words;
+
+            if (cull && isDraw(type) && !reaches(*static_cast<const GRect*>(rec), *cull)) {
+                continue;
+            }
+            switch (type) {
+                case kSave_Op:
+                    canvas->save();
+                    saveCount += 1;
+                    break;
+                case kRestore_Op:
+                    canvas->restore();
+                    saveCount -= 1;
+                    break;
+                case kConcat_Op:
+                    canvas->concat(static_cast<const Concat*>(rec)->matrix);
+                    break;
+                case kClipRect_Op:
+                    canvas->clipRect(static_cast<const ClipRect*>(rec)->rect);
+                    break;
+                case kClipPath_Op:
+                    canvas->clipPath(*fPaths[static_cast<const ClipPath*>(rec)->path]);
+                    break;
+                case kClear_Op: {
+                    const GColor& color = static_cast<const Clear*>(rec)->color;
+                    if (!band) {
+                        canvas->clear(color);
+                        break;
+                    }
+                    // Clear ignores the clip, so a band fills only its own rows
+                    GPixel pixel = ColorToPixel(color);
+                    for (int y = static_cast<int>(cull->top); y < static_cast<int>(cull->bottom); ++y) {
+                        std::fill_n(band->getAddr(0, y), band->width(), pixel);
+                    }
+                    break;
+                }
+                case kDrawRect_Op: {
+                    auto r = static_cast<const DrawRect*>(rec);
+                    canvas->drawRect(r->rect, paints[r->paint]);
+                    break;
+                }
+                case kDrawConvexPolygon_Op: {
+                    auto r = static_cast<const DrawConvexPolygon*>(rec);
+                    auto points = reinterpret_cast<const GPoint*>(r + 1);
+                    canvas->drawConvexPolygon(points, r->count, paints[r->paint]);
+                    break;
+                }
+                case kDrawPath_Op: {
+                    auto r = static_cast<const DrawPath*>(rec);
+                    canvas->drawPath(*fPaths[r->path], paints[r->paint]);
+                    break;
+                }
+                case kDrawMesh_Op: {
+                    auto r = static_cast<const DrawMesh*>(rec);
+                    auto indices = reinterpret_cast<const int*>(r + 1);
+                    auto verts = reinterpret_cast<const GPoint*>(indices + r->count * 3);
+                    const GColor* colors = nullptr;
+                    const GPoint* texs = nullptr;
+                    const void* next = verts + r->vertexCount;
+                    if (r->hasColors) {
+                        colors = static_cast<const GColor*>(next);
+                        next = colors + r->vertexCount;
+                    }
+                    if (r->hasTexs) {
+                        texs = static_cast<const GPoint*>(next);
+                    }
+                    canvas->drawMesh(verts, colors, texs, r->count, indices, paints[r->paint]);
+                    break;
+                }
+                case kDrawQuad_Op: {
+                    auto r = static_cast<const DrawQuad*>(rec);
+                    auto verts = reinterpret_cast<const GPoint*>(r + 1);
+                    const GColor* colors = nullptr;
+                    const GPoint* texs = nullptr;
+                    const void* next = verts + 4;
+                    if (r->hasColors) {
+                        colors = static_cast<const GColor*>(next);
+                        next = colors + 4;
+                    }
+                    if (r->hasTexs) {
+                        texs = static_cast<const GPoint*>(next);
+                    }
+                    canvas->drawQuad(verts, colors, texs, r->level, paints[r->paint]);
+                    break;
+                }
+                case kDrawStroke_Op: {
+                    auto r = static_cast<const DrawStroke*>(rec);
+                    Stroker::Draw(canvas, *fPaths[r->path], r->width, r->join, r->cap,
+                                  paints[r->paint]);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Undo any saves the recording left open, then our own
+    for (; saveCount > 0; --saveCount) {
+        canvas->restore();
+    }
+    canvas->restore();
+}
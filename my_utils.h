@@ -36,6 +36,7 @@ struct Edge {
     int winding;    // Winding value (+1 for up, -1 for down)
     float slope;
     float b;
+    float x;        // Running X at the current scanline center, advanced by slope each row
 
     Edge(float x0, float x1, float y0, float y1, int winding)
         : winding(winding) {
@@ -43,6 +44,7 @@ struct Edge {
             top = GRoundToInt(y0);
             bottom = GRoundToInt(y1);
             b = x0 - slope * y0;
+            x = computeX(top);
         }
 
     // Compute the X coordinate at a specific Y value (used for scan conversion)
@@ -66,6 +68,61 @@ inline bool compareEdges(const Edge& a, const Edge& b) {
     return a.slope < b.slope; // Compare based on the slope or initial x-values
 }
 
+// Re-sort the active edges by their running X. Edges only drift by their slope between
+// scanlines, so the list is almost always already in order and this is close to linear.
+inline void sortActiveEdges(std::vector<Edge>& active) {
+    for (size_t i = 1; i < active.size(); ++i) {
+        Edge edge = active[i];
+        size_t j = i;
+        while (j > 0 && active[j - 1].x > edge.x) {
+            active[j] = active[j - 1];
+            --j;
+        }
+        active[j] = edge;
+    }
+}
+
+// Walks one side of a convex polygon downward, one edge at a time, starting from its top vertex.
+// Two of these (stepping +1 and -1 around the polygon) bound every scanline of a convex shape.
+class ConvexChain {
+public:
+    ConvexChain(const GPoint pts[], int count, int start, int step)
+        : fPts(pts), fCount(count), fIndex(start), fStep(step), fRemaining(count),
+          fEdge(0, 0, 0, 1, 0) {
+        fEdge.bottom = fEdge.top;  // Start out exhausted so the first seek() loads an edge
+    }
+
+    // Make the current edge the one crossing scanline y. Returns false once the chain runs out.
+    bool seek(int y) {
+        while (fEdge.bottom <= y) {
+            if (fRemaining == 0) {
+                return false;
+            }
+            GPoint p0 = fPts[fIndex];
+            fIndex = (fIndex + fStep + fCount) % fCount;
+            GPoint p1 = fPts[fIndex];
+            --fRemaining;
+
+            if (p0.y == p1.y) {
+                continue;  // Horizontal edges never cross a scanline
+            }
+            fEdge = p0.y < p1.y ? Edge(p0.x, p1.x, p0.y, p1.y, +1)
+                                : Edge(p1.x, p0.x, p1.y, p0.y, -1);
+        }
+        return true;
+    }
+
+    float computeX(int y) const { return fEdge.computeX(y); }
+
+private:
+    const GPoint* fPts;
+    int fCount;
+    int fIndex;
+    int fStep;
+    int fRemaining;
+    Edge fEdge;
+};
+
 inline void addEdge(std::vector<Edge>& edges, const GPoint& p0, const GPoint& p1) {
     if (p0.y == p1.y) {
         
@@ -143,6 +200,31 @@ inline GRect computeBounds(const GPoint points[], int count) {
     return GRect::LTRB(left, top, right, bottom);
 }
 
+// The pixels whose centers are inside bounds, limited to clip. Rounds after clamping, so
+// bounds far outside the device can't overflow.
+inline GIRect intersectBounds(const GIRect& clip, const GRect& bounds) {
+    GRect r = GRect::LTRB(std::max(bounds.left, (float)clip.left),
+                          std::max(bounds.top, (float)clip.top),
+                          std::min(bounds.right, (float)clip.right),
+                          std::min(bounds.bottom, (float)clip.bottom));
+    if (r.isEmpty()) {
+        return GIRect::LTRB(0, 0, 0, 0);
+    }
+    return r.round();
+}
+
+// Bounds of rect after mapping its corners; conservative for any affine matrix
+inline GRect mapBounds(const GMatrix& matrix, const GRect& rect) {
+    GPoint corners[4] = {
+        {rect.left, rect.top},
+        {rect.right, rect.top},
+        {rect.right, rect.bottom},
+        {rect.left, rect.bottom},
+    };
+    matrix.mapPoints(corners, corners, 4);
+    return computeBounds(corners, 4);
+}
+
 
 inline GPixel blend_clear(GPixel src, GPixel dst){
     return 0;
@@ -309,178 +391,49 @@ inline GPixel blend_xor(GPixel src, GPixel dst) {
     return PACK_ARGB(A, R, G, B);
 }
 
+// Reduce a blend mode for a source whose alpha is known to be 0 or 1 for every pixel.
+// Every reduction here produces exactly the same pixels as the unreduced mode.
 inline GBlendMode optimize(GBlendMode mode, float alpha) {
     
     // 100% Opaque (alpha == 1.0)
     if (alpha == 1.0f) {
-        // printf("Optimizing because opaque!");
         if (mode == GBlendMode::kSrcOver) {
             return GBlendMode::kSrc;  // No need for SrcOver when source is fully opaque
         } 
-        if (mode == GBlendMode::kSrcIn) {
-            return GBlendMode::kSrc;  // SrcIn becomes Src if source is fully opaque
-        } 
         if (mode == GBlendMode::kDstIn) {
             return GBlendMode::kDst;  // DstIn becomes Dst if source is fully opaque
         } 
-        
-        if (mode == GBlendMode::kDstOver) {
-            return GBlendMode::kDst;  // DstOver becomes Dst if source is fully opaque
-        } 
-        if (mode == GBlendMode::kSrcOut) {
-            return GBlendMode::kClear; // SrcOut becomes Clear if source is fully opaque
+        if (mode == GBlendMode::kDstOut) {
+            return GBlendMode::kClear; // DstOut becomes Clear if source is fully opaque
         } 
         if (mode == GBlendMode::kSrcATop) {
-            return GBlendMode::kDst;  // SrcATop becomes Dst if source is fully opaque
+            return GBlendMode::kSrcIn;  // SrcATop becomes SrcIn if source is fully opaque
+        } 
+        if (mode == GBlendMode::kDstATop) {
+            return GBlendMode::kDstOver;  // DstATop becomes DstOver if source is fully opaque
         } 
         if (mode == GBlendMode::kXor) {
-            return GBlendMode::kDstOut;  // XOR becomes DstOut if source is fully opaque
+            return GBlendMode::kSrcOut;  // XOR becomes SrcOut if source is fully opaque
         } 
-        
     }
 
-    // 100% Transparent (alpha == 0.0)
+    // 100% Transparent (alpha == 0.0), so the premultiplied source is all zeros
     if (alpha == 0.0f) {
-        // printf("Optimizing because transparent!");
-        if (mode == GBlendMode::kSrcIn) {
-            return GBlendMode::kClear;  // SrcIn becomes Clear if source is fully transparent
-        } 
-        if (mode == GBlendMode::kDstOut) {
-            return GBlendMode::kClear;  // DstOut becomes Clear if source is fully transparent
-        } 
-        if (mode == GBlendMode::kSrcOver) {
-            return GBlendMode::kDst;    // SrcOver with transparent source becomes Dst
-        } 
-        if (mode == GBlendMode::kSrcATop) {
-            return GBlendMode::kDst;    // SrcATop with transparent source becomes Dst
+        if (mode == GBlendMode::kSrc || mode == GBlendMode::kSrcIn || mode == GBlendMode::kSrcOut) {
+            return GBlendMode::kClear;  // Only the (zero) source survives
         } 
-        if (mode == GBlendMode::kDstIn) {
-            return GBlendMode::kClear;  // DstIn becomes Clear if source is fully transparent
-        } 
-        if (mode == GBlendMode::kXor) {
-            return GBlendMode::kDst;    // XOR with transparent source becomes Dst
+        if (mode == GBlendMode::kDstIn || mode == GBlendMode::kDstATop) {
+            return GBlendMode::kClear;  // Destination is scaled by the zero source alpha
         } 
-        if (mode == GBlendMode::kSrcOut) {
-            return GBlendMode::kClear;  // SrcOut with transparent source becomes Clear
+        if (mode == GBlendMode::kSrcOver || mode == GBlendMode::kDstOver || mode == GBlendMode::kDstOut ||
+            mode == GBlendMode::kSrcATop || mode == GBlendMode::kXor) {
+            return GBlendMode::kDst;    // Destination is left untouched
         } 
     }
 
     return mode; // No optimization applicable
 }
 
-inline BlendFunc* get_func(GBlendMode blendMode){
-    switch (blendMode) {
-        case GBlendMode::kClear:
-            return blend_clear;
-        case GBlendMode::kSrc:
-            return blend_src;
-        case GBlendMode::kDst:
-            return blend_dst;
-        case GBlendMode::kSrcOver:
-            return blend_srcOver;
-        case GBlendMode::kDstOver:
-            return blend_dstOver;
-        case GBlendMode::kSrcIn:
-            return blend_srcIn;
-        case GBlendMode::kDstIn:
-            return blend_dstIn;
-        case GBlendMode::kSrcOut:
-            return blend_srcOut;
-        case GBlendMode::kDstOut:
-            return blend_dstOut;
-        case GBlendMode::kSrcATop:
-            return blend_srcATop;
-        case GBlendMode::kDstATop:
-            return blend_dstATop;
-        case GBlendMode::kXor:
-            return blend_xor;
-    }
-}
-
-inline void blit(float leftX, int y, float width, const GPaint& paint, const GBitmap& fDevice, const GMatrix& ctm) {
-    // Log the values of leftX, width, and y
-    // std::cout << "blit called with: leftX = " << leftX << ", width = " << width << ", y = " << y << std::endl;
-
-    // Ensure y is within valid bounds
-    if (y < 0 || y >= fDevice.height()) {
-        // std::cout << "Skipping blit because y is out of bounds: " << y << std::endl;
-        return;  // Skip drawing if y is out of bounds
-    }
-    
-    // Ensure width is valid (i.e., positive)
-    int intWidth = GRoundToInt(width);
-    if (intWidth <= 0) {
-        // std::cout << "Skipping blit because intWidth is invalid: " << intWidth << std::endl;
-        return;  // Skip if the width is zero or negative
-    }
-
-    // Ensure leftX is within valid bounds
-    int intLeftX = GRoundToInt(leftX);
-    if (intLeftX >= fDevice.width()) {
-        // std::cout << "Skipping blit because intLeftX is out of bounds: " << intLeftX << std::endl;
-        return;  // Skip if the starting X is out of bounds
-    }
-
-    // Adjust if leftX is negative to prevent accessing out-of-bounds pixels
-    if (intLeftX < 0) {
-        // std::cout << "Adjusting leftX because it is negative: " << intLeftX << std::endl;
-        intWidth += intLeftX;  // Adjust the width to account for the negative offset
-        intLeftX = 0;
-    }
-
-    // Bound the width so we don't overrun the right edge
-    if (intLeftX + intWidth > fDevice.width()) {
-        // std::cout << "Adjusting intWidth because it exceeds the right edge" << std::endl;
-        intWidth = fDevice.width() - intLeftX;
-    }
-
-    // Ensure intWidth is still valid after all adjustments
-    if (intWidth <= 0) {
-        // std::cout << "Skipping blit because intWidth is now invalid after adjustments: " << intWidth << std::endl;
-        return;  // Skip if width becomes non-positive after adjustments
-    }
-
-    // std::cout << "Final values before shading: leftX = " << intLeftX << ", width = " << intWidth << ", y = " << y << std::endl;
-
-    GShader* shader = paint.peekShader();
-    GBlendMode blendMode = paint.getBlendMode();
-    BlendFunc* blender = get_func(blendMode);
-
-    if (shader && shader->setContext(ctm)) {
-        // Allocate row buffer based on calculated width
-        GPixel row[intWidth];
-        shader->shadeRow(intLeftX, y, intWidth, row);
-
-        // Get the destination row and apply the pixels with blending
-        GPixel* row_addr = fDevice.getAddr(0, y);
-        for (int i = 0; i < intWidth; ++i) {
-            int x = intLeftX + i;
-            if (x >= 0 && x < fDevice.width()) {  // Ensure x is within bounds
-                GPixel dstPixel = row_addr[x];  // Get destination pixel
-                GPixel srcPixel = row[i];       // Get source pixel from shader
-                row_addr[x] = blender(srcPixel, dstPixel);  // Apply blend mode
-            }
-        }
-    } else {
-        // Fallback: No shader, use solid color
-        GPixel srcPixel = ColorToPixel(paint.getColor());
-
-        // Apply the solid color with blending
-        GPixel* row_addr = fDevice.getAddr(0, y);
-        for (int i = 0; i < intWidth; ++i) {
-            int x = intLeftX + i;
-            if (x >= 0 && x < fDevice.width()) {  // Ensure x is within bounds
-                GPixel dstPixel = row_addr[x];  // Get destination pixel
-                row_addr[x] = blender(srcPixel, dstPixel);  // Apply blend mode
-            }
-        }
-    }
-
-    // std::cout << "blit finished successfully for y = " << y << std::endl;
-}
-
-
-
 // Helper function to solve quadratic equation ax^2 + bx + c = 0
 inline std::vector<float> solveQuadratic(float a, float b, float c) {
     std::vector<float> roots;
@@ -607,46 +560,69 @@ inline GPoint lerp(const GPoint& p0, const GPoint& p1, float t) {
     };
 }
 
-// Helper function to flatten a quadratic curve with adaptive subdivision
-inline void flattenQuad(const GPoint src[3], std::vector<Edge>& edges, const GMatrix& matrix, float tolerance) {
-    // Calculate midpoint for flatness test
-    GPoint mid = lerp(lerp(src[0], src[1], 0.5f), lerp(src[1], src[2], 0.5f), 0.5f);
-
-    // Check if midpoint is within tolerance of the line segment endpoints
-    float dist = std::sqrt((mid.x - src[1].x) * (mid.x - src[1].x) + (mid.y - src[1].y) * (mid.y - src[1].y));
-    if (dist <= tolerance) {
-        // If flat, map points and add edge
-        GPoint mappedPoints[2] = { src[0], src[2] };
-        matrix.mapPoints(mappedPoints, mappedPoints, 2);
-        addEdge(edges, mappedPoints[0], mappedPoints[1]);
-    } else {
-        // Otherwise, subdivide and flatten each part
-        GPoint dst[5];
-        GPath::ChopQuadAt(src, dst, 0.5f);
-        flattenQuad(dst, edges, matrix, tolerance);       // Left half
-        flattenQuad(dst + 2, edges, matrix, tolerance);   // Right half
+// Number of equal steps in t that keeps every chord of a quad (count 3) or cubic (count 4)
+// within tolerance of the curve. A chord over a step h strays at most max|B''| h^2 / 8, and
+// |B''| is 2|P0 - 2P1 + P2| for a quad and at most 6 * max(|P0 - 2P1 + P2|, |P1 - 2P2 + P3|)
+// for a cubic, so the count comes straight from the control points with a single sqrt.
+inline int curveSegmentCount(const GPoint pts[], int count, float tolerance) {
+    float secondDiff = (pts[0] - 2 * pts[1] + pts[2]).length();
+    float maxSecond = 2 * secondDiff;
+    if (count == 4) {
+        maxSecond = 6 * std::max(secondDiff, (pts[1] - 2 * pts[2] + pts[3]).length());
     }
-}
-
-// Helper function to flatten a cubic curve with adaptive subdivision
-inline void flattenCubic(const GPoint src[4], std::vector<Edge>& edges, const GMatrix& matrix, float tolerance) {
-    // Calculate midpoints for flatness test
-    GPoint mid1 = lerp(src[0], src[3], 0.5f);
-    GPoint mid2 = lerp(src[1], src[2], 0.5f);
-    float dist = std::sqrt((mid1.x - mid2.x) * (mid1.x - mid2.x) + (mid1.y - mid2.y) * (mid1.y - mid2.y));
-
-    if (dist <= tolerance) {
-        // If flat, map points and add edge
-        GPoint mappedPoints[2] = { src[0], src[3] };
-        matrix.mapPoints(mappedPoints, mappedPoints, 2);
-        addEdge(edges, mappedPoints[0], mappedPoints[1]);
+    float segments = std::ceil(std::sqrt(maxSecond / (8 * tolerance)));
+    if (!(segments >= 1)) {
+        return 1;  // Straight, or not finite
+    }
+    return static_cast<int>(std::min(segments, 4096.0f));
+}
+
+// Walks a quad (count 3) or cubic (count 4) in segments equal steps of t by forward
+// differencing, calling proc with each point after the start; the last is exactly the end.
+template <typename Proc>
+inline void forEachCurvePoint(const GPoint pts[], int count, int segments, Proc&& proc) {
+    float h = 1.0f / segments;
+    GPoint p = pts[0];
+    GVector d1, d2, d3 = {0, 0};
+    if (count == 3) {
+        // B(t) = A t^2 + B t + P0
+        GVector A = pts[0] - 2 * pts[1] + pts[2];
+        GVector B = 2 * (pts[1] - pts[0]);
+        d1 = (h * h) * A + h * B;
+        d2 = (2 * h * h) * A;
     } else {
-        // Otherwise, subdivide and flatten each part
-        GPoint dst[7];
-        GPath::ChopCubicAt(src, dst, 0.5f);
-        flattenCubic(dst, edges, matrix, tolerance);       // Left half
-        flattenCubic(dst + 3, edges, matrix, tolerance);   // Right half
+        // B(t) = A t^3 + B t^2 + C t + P0
+        GVector A = pts[3] - 3 * pts[2] + 3 * pts[1] - pts[0];
+        GVector B = 3 * (pts[2] - 2 * pts[1] + pts[0]);
+        GVector C = 3 * (pts[1] - pts[0]);
+        d1 = (h * h * h) * A + (h * h) * B + h * C;
+        d2 = (6 * h * h * h) * A + (2 * h * h) * B;
+        d3 = (6 * h * h * h) * A;
     }
+    for (int i = 1; i < segments; ++i) {
+        p += d1;
+        d1 += d2;
+        d2 += d3;
+        proc(p);
+    }
+    proc(pts[count - 1]);
+}
+
+// Adds the edges of a quad (count 3) or cubic (count 4) flattened in device space, to within
+// tolerance device pixels. The control points are mapped once; an affine map of a bezier is
+// the bezier of the mapped points. Edges are added scaled by scale, e.g. onto a supersampled
+// grid, without changing how finely the curve is flattened.
+inline void flattenCurve(const GPoint src[], int count, std::vector<Edge>& edges,
+                         const GMatrix& matrix, float tolerance, GVector scale = {1, 1}) {
+    GPoint mapped[4];
+    matrix.mapPoints(mapped, src, count);
+    int segments = curveSegmentCount(mapped, count, tolerance);
+    GPoint prev = {mapped[0].x * scale.x, mapped[0].y * scale.y};
+    forEachCurvePoint(mapped, count, segments, [&](GPoint p) {
+        p = {p.x * scale.x, p.y * scale.y};
+        addEdge(edges, prev, p);
+        prev = p;
+    });
 }
 
 inline float tileClamp(float value, float max) {
@@ -674,130 +650,6 @@ inline GColor lerpColor(const GColor& c0, const GColor& c1, float t) {
     ).pinToUnit();
 }
 
-/*// Tessellate a quad into triangles
-inline void tessellateQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4],
-                           int level, std::vector<GPoint>& outVerts, std::vector<GColor>& outColors,
-                           std::vector<GPoint>& outTexs, std::vector<int>& outIndices) {
-    int n = 1 << level;  // Number of subdivisions per side
-    float step = 1.0f / n;
-
-    // Generate vertices
-    for (int y = 0; y <= n; ++y) {
-        for (int x = 0; x <= n; ++x) {
-            float u = x * step;
-            float v = y * step;
-
-            // Interpolate positions
-            GPoint pt = lerp(lerp(verts[0], verts[1], u), lerp(verts[3], verts[2], u), v);
-            outVerts.push_back(pt);
-
-            // Interpolate colors
-            if (colors) {
-                GColor colTop = lerpColor(colors[0], colors[1], u);
-                GColor colBottom = lerpColor(colors[3], colors[2], u);
-                GColor col = lerpColor(colTop, colBottom, v); // Interpolate vertically
-                outColors.push_back(col);
-            }
-
-
-            // Interpolate texture coordinates
-            if (texs) {
-                GPoint tex = lerp(lerp(texs[0], texs[1], u), lerp(texs[3], texs[2], u), v);
-                outTexs.push_back(tex);
-            }
-        }
-    }
-
-    // Generate triangle indices
-    for (int y = 0; y < n; ++y) {
-        for (int x = 0; x < n; ++x) {
-            int topLeft = y * (n + 1) + x;
-            int topRight = topLeft + 1;
-            int bottomLeft = topLeft + (n + 1);
-            int bottomRight = bottomLeft + 1;
-
-            outIndices.push_back(topLeft);
-            outIndices.push_back(topRight);
-            outIndices.push_back(bottomRight);
-
-            outIndices.push_back(topLeft);
-            outIndices.push_back(bottomRight);
-            outIndices.push_back(bottomLeft);
-        }
-    }
-}*/
-
-// Tessellate a quad into triangles
-inline void tessellateQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4],
-                           int level, std::vector<GPoint>& outVerts, std::vector<GColor>& outColors,
-                           std::vector<GPoint>& outTexs, std::vector<int>& outIndices) {
-    int n = level+1;  // Number of subdivisions per side
-    // int n = 1 << std::min(4, level);  // Number of subdivisions per side, hard coded
-    // Threshold to stop adding degenerate triangles
-    constexpr float epsilon = 1e-5f;
-    float step = std::max(1.0f / n, epsilon); // Look into step and epsilon usage
-
-    
-
-    // Generate vertices
-    for (int y = 0; y <= n; ++y) {
-        for (int x = 0; x <= n; ++x) {
-            float u = x * step;
-            float v = y * step;
-
-            // Interpolate positions
-            GPoint pt = lerp(lerp(verts[0], verts[1], u), lerp(verts[3], verts[2], u), v);
-            outVerts.push_back(pt);
-
-            // Interpolate colors
-            if (colors) {
-                GColor colTop = lerpColor(colors[0], colors[1], u);
-                GColor colBottom = lerpColor(colors[3], colors[2], u);
-                GColor col = lerpColor(colTop, colBottom, v);  // Interpolate vertically
-                outColors.push_back(col);
-            }
-
-            // Interpolate texture coordinates
-            if (texs) {
-                GPoint tex = lerp(lerp(texs[0], texs[1], u), lerp(texs[3], texs[2], u), v);
-                outTexs.push_back(tex);
-            }
-        }
-    }
-
-    // Generate triangle indices
-    for (int y = 0; y < n; ++y) {
-        for (int x = 0; x < n; ++x) {
-            int topLeft = y * (n + 1) + x;
-            int topRight = topLeft + 1;
-            int bottomLeft = topLeft + (n + 1);
-            int bottomRight = bottomLeft + 1;
-
-            // Compute area of each triangle and avoid degenerate triangles
-            float area1 = fabsf((outVerts[topLeft].x * (outVerts[topRight].y - outVerts[bottomRight].y) +
-                                 outVerts[topRight].x * (outVerts[bottomRight].y - outVerts[topLeft].y) +
-                                 outVerts[bottomRight].x * (outVerts[topLeft].y - outVerts[topRight].y)) * 0.5f);
-
-            float area2 = fabsf((outVerts[topLeft].x * (outVerts[bottomRight].y - outVerts[bottomLeft].y) +
-                                 outVerts[bottomRight].x * (outVerts[bottomLeft].y - outVerts[topLeft].y) +
-                                 outVerts[bottomLeft].x * (outVerts[topLeft].y - outVerts[bottomRight].y)) * 0.5f);
-
-            if (area1 > epsilon) {
-                outIndices.push_back(topLeft);
-                outIndices.push_back(topRight);
-                outIndices.push_back(bottomRight);
-            }
-
-            if (area2 > epsilon) {
-                outIndices.push_back(topLeft);
-                outIndices.push_back(bottomRight);
-                outIndices.push_back(bottomLeft);
-            }
-        }
-    }
-}
-
-
 // Calculate the texture transformation matrix
 inline GMatrix calculateTextureTransform(const GPoint& t0, const GPoint& t1, const GPoint& t2,
                                          const GPoint& p0, const GPoint& p1, const GPoint& p2) {
@@ -13,17 +13,26 @@
 #include "include/GPaint.h"
 #include "include/GMatrix.h"
 #include "include/GPath.h"
+#include "include/GStrokeCanvas.h"
+#include "Blitter.h"
+#include "QuadTessellation.h"
+#include "ThreadPool.h"
+#include <functional>
 #include <stack>
+#include <vector>
 
-class MyCanvas : public GCanvas {
+class MyCanvas : public GStrokeCanvas {
 public:
-    MyCanvas(const GBitmap& device) : fDevice(device) {
+    MyCanvas(const GBitmap& device) : fDevice(device), fRowBuffer(device.width()) {
         fMatrixStack.push(GMatrix());  // Initialize with identity matrix
+        fClipStack.push({GIRect::WH(device.width(), device.height()), nullptr});
     }
 
     void save() override;
     void restore() override;
     void concat(const GMatrix& matrix) override;
+    void clipRect(const GRect& rect) override;
+    void clipPath(const GPath& path) override;
 
     void clear(const GColor& color) override;
     void fillRectX(const GRect& rect, const GColor& color);
@@ -32,10 +41,95 @@ public:
     void drawPath(const GPath& path, const GPaint& paint) override;  // For non-convex polygons
     void drawMesh(const GPoint verts[], const GColor colors[], const GPoint texs[], int count, const int indices[], const GPaint& paint) override;
     void drawQuad(const GPoint verts[4], const GColor colors[4], const GPoint texs[4], int level, const GPaint& paint) override;
+
+    // Strokes at most a pixel wide on the device are drawn as hairlines, others as outlines
+    void drawStroke(const GPath& path, float width, GStrokeJoin join, GStrokeCap cap,
+                    const GPaint& paint) override;
     // void drawTriangleWithTex(const GPoint pts[3], const GPoint tex[3], GShader* originalShader);
-private:
+
+    // Rasterizers restart their incremental edge stepping every kBandHeight rows, so a draw
+    // produces the same pixels no matter how its rows are split into bands of this size.
+    static constexpr int kBandHeight = 64;
+
+protected:
+    using BandProc = std::function<void(int top, int bottom, int worker, Blitter& blitter)>;
+
+    // Run proc over the device rows [top, bottom). Subclasses may split the rows into bands
+    // (multiples of kBandHeight) and run them concurrently, each with its own Blitter copy.
+    // worker, in [0, bandWorkers()), is unique among the bands running at the same time, and
+    // worker 0 is always the calling thread.
+    virtual void forEachBand(int top, int bottom, const Blitter& blitter, const BandProc& proc);
+
+    // How many bands forEachBand may run at the same time
+    virtual int bandWorkers() const { return 1; }
+
     const GBitmap fDevice;
+
+private:
+    // True if nothing inside these device-space bounds can touch a pixel center in the clip
+    bool quickReject(const GRect& bounds) const {
+        const GIRect& clip = fClipStack.top().bounds;
+        return !(bounds.right > clip.left && bounds.bottom > clip.top &&
+                 bounds.left < clip.right && bounds.top < clip.bottom);
+    }
+
+    void scanConvex(const GPoint pts[], int count, Blitter& blitter);  // pts are in device space
+    // Scans only rows [top, bottom), which must already be within the clip, on this thread
+    void scanConvexRows(const GPoint pts[], int count, int top, int bottom, Blitter& blitter);
+    void drawPathAA(const GPath& path, const GPaint& paint);
+
+    // True if a stroke this wide is at most a pixel wide on the device under the current matrix
+    bool isHairline(float width) const;
+
+    // Draws every segment of the path as a line one device pixel wide (antialiased if the paint
+    // is), straight through the blitter with no edge list. Contours are not implicitly closed.
+    void drawHairline(const GPath& path, const GPaint& paint);
+    bool prepareWorkerTextures(GShader* texture);
+
     std::stack<GMatrix> fMatrixStack;  // Stack of transformation matrices
+    std::stack<Clip>    fClipStack;    // Device-space clip per save level
+    std::vector<GPixel> fRowBuffer;    // Shader scratch row shared by every Blitter
+    QuadTessellation    fQuadTessellation;  // drawQuad's grids and vertex buffers
+
+    // drawMesh's scratch, reused from call to call: each triangle's device points and rows, and
+    // the visible triangles binned by the kBandHeight bands they touch (bin i is
+    // fMeshBins[fMeshBinStart[i] ... fMeshBinStart[i + 1]))
+    struct MeshTriangle {
+        GPoint pts[3];
+        int    top, bottom;  // Rows within the clip; empty when culled
+    };
+    std::vector<MeshTriangle> fMeshTriangles;
+    std::vector<int>          fMeshBinStart;
+    std::vector<int>          fMeshBins;
+
+    // One copy of the last mesh texture per band worker, kept while meshes keep using that
+    // texture. [0] stays null: worker 0 is the drawing thread, which uses the texture itself.
+    std::vector<std::shared_ptr<GShader>> fWorkerTextures;
+    std::weak_ptr<GShader>                fWorkerTextureSource;
+};
+
+// Renders with a pool of threads: every draw is rasterized band by band, with the bands of one
+// draw running in parallel and each draw finishing before the next starts. Output matches
+// MyCanvas pixel for pixel.
+//
+// Shaders are placed (setContext) once per draw on the calling thread, after which shadeRow()
+// is called from several threads at once, so it must not modify the shader. Mesh textures are
+// the exception: they are placed again for every triangle, so each worker shades with its own
+// copy. A texture that isn't a CopyableShader can't be copied, so meshes using it fall back
+// to drawing their bands one after another on the calling thread.
+class ParallelCanvas : public MyCanvas {
+public:
+    ParallelCanvas(const GBitmap& device, int threadCount)
+        : MyCanvas(device), fPool(threadCount),
+          fRowBuffers(static_cast<size_t>(fPool.threadCount()) * device.width()) {}
+
+protected:
+    void forEachBand(int top, int bottom, const Blitter& blitter, const BandProc& proc) override;
+    int bandWorkers() const override { return fPool.threadCount(); }
+
+private:
+    ThreadPool fPool;
+    std::vector<GPixel> fRowBuffers;  // One shader scratch row per worker
 };
 
 #endif